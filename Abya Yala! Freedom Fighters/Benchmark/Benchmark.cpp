@@ -0,0 +1,342 @@
+// Headless scaling benchmark for the entity manager and the play scene's
+// systems. Nothing here opens a window or loads assets, so it runs on a
+// build box without a display:
+//
+//     make && ./benchmark [maxEntities] [frames] [workerThreads]
+//
+// Scene_Play needs a GameEngine and a RenderWindow, so the level here is
+// synthetic, but it is run through the same Systems functions the scene
+// calls. Only the scene's own rules are left out: player input, enemy AI
+// and the contact handlers.
+
+#include "EntityManager.h"
+#include "Entity.h"
+#include "Physics.h"
+#include "Systems.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <sys/resource.h>
+
+// every allocation made by the process, so a frame's allocator traffic can be
+// read off as the difference of two samples
+static std::atomic<size_t> g_allocations{ 0 };
+
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept						{ std::free(p); }
+void operator delete[](void* p) noexcept					{ std::free(p); }
+void operator delete(void* p, size_t) noexcept				{ std::free(p); }
+void operator delete[](void* p, size_t) noexcept			{ std::free(p); }
+
+
+namespace {
+
+	const EntityTag TileTag = EntityManager::tagId("tile");
+	const EntityTag EnemyTag = EntityManager::tagId("enemy");
+	const EntityTag BulletTag = EntityManager::tagId("bullet");
+	const EntityTag CoinTag = EntityManager::tagId("coin");
+
+	enum : uint32_t { BulletLayer, EnemyLayer, CoinLayer };
+
+	struct Timing
+	{
+		double	ns{ 0 };
+		size_t	allocations{ 0 };
+	};
+
+	long peakRssKb()
+	{
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+	}
+
+	template <typename F>
+	Timing measure(size_t frames, F&& system)
+	{
+		size_t allocationsBefore = g_allocations.load();
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < frames; ++i)
+			system();
+		auto end = std::chrono::steady_clock::now();
+
+		Timing timing;
+		timing.ns = std::chrono::duration<double, std::nano>(end - start).count() / frames;
+		timing.allocations = (g_allocations.load() - allocationsBefore) / frames;
+		return timing;
+	}
+
+
+	class Level
+	{
+		EntityManager	m_entities;
+		ThreadPool&		m_threads;
+		sf::Texture		m_texture;			// never loaded, the animations only need a reference
+		Animation		m_tileAnimation{ "Tile", m_texture };
+		Animation		m_enemyAnimation{ "Enemy", m_texture, 8, 6 };
+		Animation		m_arrowAnimation{ "Arrow", m_texture, 4, 4 };
+		Animation		m_coinAnimation{ "Coin", m_texture, 6, 5 };
+		std::mt19937	m_random{ 1 };
+		float			m_width;
+		PrefabRegistry	m_prefabs;
+		Physics::TileGrid		m_tileGrid{ Vec2(50, 50) };
+		Physics::SpatialHash	m_ground{ 100.f };		// levels have no ground pieces, kept empty as in the game
+		Physics::ContactCache	m_terrainContacts;
+		Physics::BoxBatch		m_nearby;
+		std::vector<Physics::BatchHit>	m_hits;
+		std::vector<Entity*>	m_nearbyGround;
+		Physics::CollisionMatrix	m_layers;
+		Physics::SweepAndPrune	m_dynamicPairs;
+		size_t					m_contacts{ 0 };
+
+		Vec2 randomPosition()
+		{
+			std::uniform_real_distribution<float> x(0.f, m_width), y(0.f, 768.f);
+			return Vec2(x(m_random), y(m_random));
+		}
+
+		void spawnBullet()
+		{
+			m_entities.commands().instantiate(m_prefabs.get("Bullet"), randomPosition());
+		}
+
+		// one frame of the systems the enemies' sleep depends on
+		void step()
+		{
+			m_entities.update();
+			movement();
+			collision();
+		}
+
+		// tile centres on the 50 pixel grid in platforms of up to eight,
+		// as a level file lays them out
+		std::vector<Vec2> platformPositions(size_t count)
+		{
+			std::uniform_int_distribution<int> column(0, static_cast<int>(m_width / 50.f)), row(0, 14), length(1, 8);
+			std::vector<Vec2> positions;
+			positions.reserve(count);
+			while (positions.size() < count)
+			{
+				int x = column(m_random), y = row(m_random);
+				for (int i = length(m_random); i > 0 && positions.size() < count; --i, ++x)
+					positions.emplace_back(x * 50.f + 25.f, y * 50.f + 25.f);
+			}
+			return positions;
+		}
+
+		std::vector<Vec2> randomPositions(size_t count)
+		{
+			std::vector<Vec2> positions(count);
+			for (auto& pos : positions)
+				pos = randomPosition();
+			return positions;
+		}
+
+	public:
+		// a mix close to a played level: mostly tiles, then bullets in flight,
+		// coins and enemies
+		Level(size_t count, ThreadPool& threads)
+			: m_threads(threads)
+			, m_width(static_cast<float>(count) * 2.f)
+		{
+			m_entities.reserve(count);
+
+			CTransform bulletTransform;
+			bulletTransform.vel = Vec2(5.f, 0.f);
+			CBoundingBox bulletBox(Vec2(10, 10));
+			bulletBox.swept = true;
+			m_prefabs.add("Bullet", BulletTag, CAnimation(m_arrowAnimation, true), bulletTransform, bulletBox, CLifespan(50),
+				CBody(CBody::Kinematic), CAwake());
+			m_prefabs.add("Tile", TileTag, CAnimation(m_tileAnimation, true), CTransform(), CBoundingBox(Vec2(50, 50)));
+			m_prefabs.add("Coin", CoinTag, CAnimation(m_coinAnimation, true), CTransform(), CBoundingBox(Vec2(20, 20)));
+
+			size_t tiles = count * 6 / 10;
+			size_t enemies = count / 10;
+			size_t coins = count / 10;
+			size_t bullets = count - tiles - enemies - coins;
+
+			auto placed = m_entities.instantiate(m_prefabs.get("Tile"), tiles, platformPositions(tiles));
+			std::vector<Entity*> levelTiles(placed.begin(), placed.end());
+
+			// half of the enemies stand guard on a tile, they fall asleep while
+			// the level settles so movement only pays for the ones on patrol
+			bool patrolling = false;
+			size_t guard = 0;
+			for (auto e : m_entities.addEntities(enemies, EnemyTag))
+			{
+				patrolling = !patrolling;
+				Vec2 pos = randomPosition();
+				if (!patrolling)
+				{
+					auto tile = levelTiles[guard++ * levelTiles.size() / (enemies / 2 + 1)]->getComponent<CTransform>().pos;
+					pos = Vec2(tile.x, tile.y - 25.f - 30.f);
+				}
+				e->addComponent<CAnimation>(m_enemyAnimation, true);
+				e->addComponent<CTransform>(pos).vel = Vec2(patrolling ? 1.f : 0.f, 0.f);
+				e->addComponent<CBoundingBox>(Vec2(40, 60));
+				e->addComponent<CState>();
+				e->addComponent<CHealth>(100);
+				e->addComponent<CAttackTimer>(1.0f);
+				e->addComponent<CPlatformInfo>(0.f, m_width);
+				e->addComponent<CBody>(CBody::Dynamic);
+				e->addComponent<CAwake>();
+			}
+
+			m_entities.instantiate(m_prefabs.get("Coin"), coins, randomPositions(coins));
+			m_entities.instantiate(m_prefabs.get("Bullet"), bullets, randomPositions(bullets));
+
+			m_entities.update();
+			m_tileGrid.build(levelTiles);
+
+			m_layers.setLayer(BulletTag, BulletLayer);
+			m_layers.setLayer(EnemyTag, EnemyLayer);
+			m_layers.setLayer(CoinTag, CoinLayer);
+			m_layers.onContact(BulletLayer, EnemyLayer, [this](Entity&, Entity&) { ++m_contacts; });
+			m_layers.onContact(EnemyLayer, CoinLayer, [this](Entity&, Entity&) { ++m_contacts; });
+
+			for (int i = 0; i < 2 * Physics::SleepFrames; ++i)
+				step();
+		}
+
+		size_t asleep()
+		{
+			size_t count = 0;
+			for (auto e : m_entities.getEntities(EnemyTag))
+				count += Physics::isAsleep(*e);
+			return count;
+		}
+
+		// a guard that is sent walking wakes up and leaves again, and falls
+		// back asleep once it has stood still for SleepFrames steps
+		bool checkSleep()
+		{
+			Entity* guard = nullptr;
+			for (auto e : m_entities.getEntities(EnemyTag))
+				if (Physics::isAsleep(*e) && !e->hasComponent<CAwake>())
+					guard = e;
+			if (!guard)
+				return false;
+
+			auto& tx = guard->getComponent<CTransform>();
+			float x = tx.pos.x;
+			tx.vel.x = 0.5f;
+			Physics::wake(*guard, m_entities.commands());
+			step();
+			if (Physics::isAsleep(*guard) || !guard->hasComponent<CAwake>() || tx.pos.x == x)
+				return false;
+
+			tx.vel.x = 0.f;
+			for (int i = 0; i < 2 * Physics::SleepFrames; ++i)
+				step();
+			return Physics::isAsleep(*guard) && !guard->hasComponent<CAwake>();
+		}
+
+		size_t size() { return m_entities.getEntities().size(); }
+
+		// expire a slice of the bullets and fire as many new ones, so the
+		// manager sees the same churn as a fight
+		void update()
+		{
+			auto& bullets = m_entities.getEntities(BulletTag);
+			size_t expired = bullets.size() / 100;
+			for (size_t i = 0; i < expired; ++i)
+			{
+				bullets[i]->destroy();
+				spawnBullet();
+			}
+			m_entities.update();
+		}
+
+		void movement()
+		{
+			Systems::applyGravity(m_entities, EnemyTag, 0.5f);
+			Systems::moveBodies(m_entities, m_threads);
+		}
+
+		// the terrain pass of sCollision for every enemy and bullet, returns
+		// the contacts that began or ended plus the bullets that hit something.
+		// The bullets are left alive so every frame sweeps the same number
+		size_t collision()
+		{
+			Systems::Terrain terrain{ m_tileGrid, m_ground, m_terrainContacts, m_nearby, m_hits, m_nearbyGround };
+			for (auto e : m_entities.getEntities(EnemyTag))
+				Systems::enemyTerrain(*e, terrain);
+			size_t stopped = 0;
+			for (auto b : m_entities.getEntities(BulletTag))
+				stopped += Systems::hitsGround(*b, terrain);
+			Systems::updateGrounded(m_entities, m_terrainContacts);
+			return m_terrainContacts.events().size() + stopped;
+		}
+
+		// bullets against enemies and enemies against coins, as the pair
+		// pass of sCollision does
+		size_t pairs()
+		{
+			m_contacts = 0;
+			Systems::dynamicPairs(m_entities, m_dynamicPairs, m_layers);
+			return m_contacts;
+		}
+
+		void animation()
+		{
+			Systems::advanceAnimations(m_entities, m_threads);
+		}
+	};
+
+
+	void printRow(const char* system, size_t entities, const Timing& timing)
+	{
+		std::printf("%-10s %10zu %14.2f %14.1f %12zu\n",
+			system, entities, timing.ns / entities, timing.ns / 1000.0, timing.allocations);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t maxEntities = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	size_t frames = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+	size_t threadCount = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : ThreadPool::defaultWorkerCount();
+
+	ThreadPool threads(threadCount);
+	std::printf("%zu frames per system, %zu threads, %s overlap kernel\n\n", frames, threads.concurrency(), Physics::overlapKernel());
+	std::printf("%-10s %10s %14s %14s %12s\n", "system", "entities", "ns/entity", "us/frame", "allocs/frame");
+
+	for (size_t count = 1000; count <= maxEntities; count *= 10)
+	{
+		Level level(count, threads);
+		size_t entities = level.size();
+		if (count == 1000 && !level.checkSleep())
+		{
+			std::printf("a guard did not wake up and fall asleep again\n");
+			return 1;
+		}
+		std::printf("%-10s %10zu %zu enemies asleep\n", "", entities, level.asleep());
+
+		printRow("update", entities, measure(frames, [&] { level.update(); }));
+		printRow("movement", entities, measure(frames, [&] { level.movement(); }));
+
+		size_t contacts = 0;
+		printRow("collision", entities, measure(frames, [&] { contacts += level.collision(); }));
+		printRow("pairs", entities, measure(frames, [&] { contacts += level.pairs(); }));
+
+		printRow("animation", entities, measure(frames, [&] { level.animation(); }));
+		std::printf("%-10s %10zu peak RSS %ld KB\n\n", "", entities, peakRssKb());
+	}
+}
@@ -9,15 +9,20 @@ Animation::Animation(const std::string& name, const sf::Texture& t)
 {}
 
 Animation::Animation(const std::string& name, const sf::Texture& t, size_t frameCount, size_t speed)
+	: Animation(name, t, sf::IntRect(0, 0, t.getSize().x, t.getSize().y), frameCount, speed)
+{}
+
+Animation::Animation(const std::string& name, const sf::Texture& t, const sf::IntRect& region, size_t frameCount, size_t speed)
 	: m_name(name)
 	, m_sprite(t)
+	, m_origin(region.left, region.top)
 	, m_frameCount(frameCount)
 	, m_currentFrame(0)
 	, m_speed(speed)
 {
-	m_size = Vec2(static_cast<float>(t.getSize().x) / frameCount, static_cast<float>(t.getSize().y));
+	m_size = Vec2(static_cast<float>(region.width) / frameCount, static_cast<float>(region.height));
 	m_sprite.setOrigin(m_size.x / 2.f, m_size.y / 2.f);
-	m_sprite.setTextureRect(sf::IntRect(std::floor(m_currentFrame * m_size.x), 0, m_size.x, m_size.y));
+	m_sprite.setTextureRect(sf::IntRect(m_origin.x + std::floor(m_currentFrame * m_size.x), m_origin.y, m_size.x, m_size.y));
 }
 
 void Animation::update(bool repeat)
@@ -45,7 +50,7 @@ void Animation::update(bool repeat)
 	}
 
 	// set frame rect
-	sf::IntRect frameRect(static_cast<int>(m_size.x * frame), static_cast<int>(0), static_cast<int>(m_size.x), static_cast<int>(m_size.y)); // left, top, width, height
+	sf::IntRect frameRect(m_origin.x + static_cast<int>(m_size.x * frame), m_origin.y, static_cast<int>(m_size.x), static_cast<int>(m_size.y)); // left, top, width, height
 	m_sprite.setTextureRect(frameRect);
 }
 
@@ -10,6 +10,7 @@ class Animation
 
 private:
 	sf::Sprite	m_sprite;
+	sf::Vector2i	m_origin{ 0, 0 };		// top left of the first frame in the texture
 	size_t		m_frameCount{ 1 };		// number of frames in animation
 	size_t		m_currentFrame{ 0 };	// the current from being played
 	size_t		m_speed{ 0 };			// how many game frames in one animation frame
@@ -22,6 +23,8 @@ public:
 	Animation();
 	Animation(const std::string& name, const sf::Texture& t);
 	Animation(const std::string& name, const sf::Texture& t, size_t frameCount, size_t speed);
+	// frames laid out left to right in region of t, e.g. an atlas page
+	Animation(const std::string& name, const sf::Texture& t, const sf::IntRect& region, size_t frameCount, size_t speed);
 
 	void				update(bool repeat = true);
 	void                setFlipped(bool flip);
@@ -51,6 +51,9 @@ void Assets::loadFromFile(const std::string& path) {
 			confFile >> name >> path;
 			addMusic(name, path);
 		}
+        else if (token == "Window") {
+            std::getline(confFile, token); // read by the GameEngine
+        }
         else if (token[0] == '#') {
             ; // ignore comments
         }
@@ -61,6 +64,8 @@ void Assets::loadFromFile(const std::string& path) {
         confFile >> token;
     }
     confFile.close();
+
+    packAtlas();
 }
 
 void Assets::addTexture(const std::string& textureName, const std::string& path, bool smooth)
@@ -81,6 +86,102 @@ void Assets::addTexture(const std::string& textureName, const std::string& path,
 void Assets::addAnimation(const std::string& animationName, const std::string& textureName, size_t frameCount, size_t speed)
 {
     m_animatioMap[animationName] = Animation(animationName, getTexture(textureName), frameCount, speed);
+    m_animationSources[animationName] = { textureName, frameCount, speed };
+}
+
+// Copies every texture an animation draws from onto a few large pages and
+// points the animations at their region of a page, so sprites of different
+// animations can share one draw call. Textures stay loaded on their own as
+// well, for whatever draws them directly. Pages are filled in shelves, the
+// tallest textures first; a texture too big for a page keeps its own.
+void Assets::packAtlas()
+{
+    const unsigned pageSize = std::min(sf::Texture::getMaximumSize(), AtlasPageSize);
+
+    std::vector<std::string> names;
+    for (auto& [animation, source] : m_animationSources) {
+        auto it = m_textureMap.find(source.texture);
+        if (it == m_textureMap.end())
+            continue;
+        auto size = it->second.getSize();
+        if (size.x + 2 * AtlasPadding <= pageSize && size.y + 2 * AtlasPadding <= pageSize)
+            names.push_back(source.texture);
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    std::stable_sort(names.begin(), names.end(), [this](const std::string& a, const std::string& b) {
+        return m_textureMap.at(a).getSize().y > m_textureMap.at(b).getSize().y;
+    });
+    if (names.empty())
+        return;
+
+    struct Placement
+    {
+        size_t      page;
+        sf::IntRect rect;
+    };
+    std::map<std::string, Placement> placements;
+    std::vector<unsigned> pageHeights{ 0 };
+    unsigned x = 0, y = 0, shelfHeight = 0;
+    for (auto& name : names) {
+        auto size = m_textureMap.at(name).getSize();
+        unsigned w = size.x + 2 * AtlasPadding, h = size.y + 2 * AtlasPadding;
+        if (x + w > pageSize) {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        if (y + h > pageSize) {
+            pageHeights.push_back(0);
+            x = y = shelfHeight = 0;
+        }
+        placements[name] = { pageHeights.size() - 1, sf::IntRect(x + AtlasPadding, y + AtlasPadding, size.x, size.y) };
+        x += w;
+        shelfHeight = std::max(shelfHeight, h);
+        pageHeights.back() = std::max(pageHeights.back(), y + h);
+    }
+
+    std::vector<sf::Image> pages(pageHeights.size());
+    for (size_t i = 0; i < pages.size(); ++i)
+        pages[i].create(pageSize, pageHeights[i], sf::Color::Transparent);
+
+    for (auto& [name, placed] : placements) {
+        sf::Image image = m_textureMap.at(name).copyToImage();
+        auto& page = pages[placed.page];
+        const auto& r = placed.rect;
+        page.copy(image, r.left, r.top);
+
+        // repeat the outermost pixels into the padding, so smoothing at a
+        // texture's edge does not pick up its neighbour; the corners too,
+        // they are sampled when a sprite is scaled or turned
+        page.copy(image, r.left - 1, r.top, sf::IntRect(0, 0, 1, r.height));
+        page.copy(image, r.left + r.width, r.top, sf::IntRect(r.width - 1, 0, 1, r.height));
+        page.copy(image, r.left, r.top - 1, sf::IntRect(0, 0, r.width, 1));
+        page.copy(image, r.left, r.top + r.height, sf::IntRect(0, r.height - 1, r.width, 1));
+        page.setPixel(r.left - 1, r.top - 1, image.getPixel(0, 0));
+        page.setPixel(r.left + r.width, r.top - 1, image.getPixel(r.width - 1, 0));
+        page.setPixel(r.left - 1, r.top + r.height, image.getPixel(0, r.height - 1));
+        page.setPixel(r.left + r.width, r.top + r.height, image.getPixel(r.width - 1, r.height - 1));
+    }
+
+    m_atlasPages.clear();
+    for (auto& image : pages) {
+        auto texture = std::make_unique<sf::Texture>();
+        if (!texture->loadFromImage(image)) {
+            std::cerr << "Could not create atlas page, animations keep their own textures" << std::endl;
+            m_atlasPages.clear();
+            return;
+        }
+        texture->setSmooth(true);
+        m_atlasPages.push_back(std::move(texture));
+    }
+
+    for (auto& [animation, source] : m_animationSources) {
+        auto it = placements.find(source.texture);
+        if (it != placements.end())
+            m_animatioMap[animation] = Animation(animation, *m_atlasPages[it->second.page], it->second.rect, source.frameCount, source.speed);
+    }
+    std::cout << "Packed " << placements.size() << " textures into " << m_atlasPages.size() << " atlas page(s)" << std::endl;
 }
 
 void Assets::addFont(const std::string& fontName, const std::string& path)
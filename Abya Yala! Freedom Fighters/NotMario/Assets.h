@@ -10,6 +10,16 @@
 
 class Assets
 {
+    struct AnimationSource
+    {
+        std::string texture;
+        size_t      frameCount;
+        size_t      speed;
+    };
+
+    static constexpr unsigned AtlasPageSize{ 4096 };  // or the GPU limit if that is lower
+    static constexpr unsigned AtlasPadding{ 2 };      // between packed textures, edges are extruded into it
+
 private:
     std::map<std::string, sf::Texture> m_textureMap;
     std::map<std::string, Animation> m_animatioMap;
@@ -17,6 +27,8 @@ private:
     std::map<std::string, std::unique_ptr<sf::SoundBuffer>> m_soundMap; 
     std::map<std::string, std::unique_ptr<sf::Shader>> m_shaderMap;
 	std::map<std::string, std::string> m_musicMap; 
+    std::map<std::string, AnimationSource> m_animationSources;
+    std::vector<std::unique_ptr<sf::Texture>> m_atlasPages;   // sprites point at these, so they must not move
 
 
     void addTexture(const std::string& textureName, const std::string& path, bool smooth = true);
@@ -25,6 +37,7 @@ private:
     void addSound(const std::string& soundEffectName, const std::string& path);
     void addShader(const std::string& shaderName, const std::string& path); 
     void addMusic(const std::string& musicName, const std::string& path);
+    void packAtlas();
 
 public:
     Assets();
@@ -32,6 +45,7 @@ public:
 
     const sf::Texture& getTexture(const std::string& textureName) const;
     const Animation& getAnimation(const std::string& animationName) const;
+    size_t atlasPages() const { return m_atlasPages.size(); }
     const sf::Font& getFont(const std::string& fontName) const;
     const sf::SoundBuffer& getSound(const std::string& soundEffectName) const;
     const sf::Shader& getShader(const std::string& shaderName) const;
@@ -12,4 +12,17 @@
 
 #include "Vec2.h"
 
+// Define NOTMARIO_DETERMINISTIC to build a simulation that replays bit for
+// bit: a constant step instead of the wall clock, a fixed random seed, every
+// system on the main thread and a state checksum in the log to diff against
+// a reference run. The Deterministic configuration of the project sets it
+// along with /fp:strict, other compilers need -ffp-contract=off and no
+// -ffast-math.
+#ifdef NOTMARIO_DETERMINISTIC
+constexpr bool Deterministic{ true };
+#else
+constexpr bool Deterministic{ false };
+#endif
+
 template <class T> using SPtr = std::shared_ptr < T >;
+using EntityTag = size_t;		// interned entity tag, see EntityManager::tagId
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "Components.h"
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+// every component type an Entity can hold
+using ComponentTuple = std::tuple< CTransform, CLifespan,
+	CInput, CBoundingBox, CAnimation, CGravity, CState, CHealth, CPlatformInfo, CAttackTimer, CBody, CAwake>;
+
+
+// position of T in a tuple, used to give every component type its own mask bit
+template <typename T, typename Tuple> struct TupleIndex;
+template <typename T, typename... Ts> struct TupleIndex<T, std::tuple<T, Ts...>>
+	: std::integral_constant<size_t, 0> {};
+template <typename T, typename U, typename... Ts> struct TupleIndex<T, std::tuple<U, Ts...>>
+	: std::integral_constant<size_t, 1 + TupleIndex<T, std::tuple<Ts...>>::value> {};
+
+using ComponentMask = uint32_t;
+static_assert(std::tuple_size_v<ComponentTuple> < 32, "one mask bit per component plus the live bit");
+
+template <typename... Ts>
+constexpr ComponentMask componentMask = ((ComponentMask(1) << TupleIndex<Ts, ComponentTuple>::value) | ... | 0);
+
+
+// Sparse set of one component type, keyed by entity id.
+// Components are packed contiguously so systems can stream through them;
+// removing one swaps the last component into its place.
+// References into the pool are invalidated by add() and remove().
+template <typename T>
+class ComponentPool
+{
+public:
+	using value_type = T;
+
+private:
+	static constexpr size_t npos{ static_cast<size_t>(-1) };
+
+	std::vector<size_t>	m_sparse;	// entity id -> index in m_data, npos if absent
+	std::vector<size_t>	m_dense;	// entity id owning each packed component
+	std::vector<T>		m_data;
+
+public:
+	bool has(size_t id) const
+	{
+		return id < m_sparse.size() && m_sparse[id] != npos;
+	}
+
+	T& get(size_t id)				{ return m_data[m_sparse[id]]; }
+	const T& get(size_t id) const	{ return m_data[m_sparse[id]]; }
+
+	T& add(size_t id, T&& component)
+	{
+		if (has(id))
+			return get(id) = std::move(component);
+
+		if (id >= m_sparse.size())
+			m_sparse.resize(id + 1, npos);
+		m_sparse[id] = m_data.size();
+		m_dense.push_back(id);
+		m_data.push_back(std::move(component));
+		return m_data.back();
+	}
+
+	void remove(size_t id)
+	{
+		if (!has(id))
+			return;
+
+		size_t index = m_sparse[id];
+		size_t last = m_data.size() - 1;
+		if (index != last)
+		{
+			m_data[index] = std::move(m_data[last]);
+			m_dense[index] = m_dense[last];
+			m_sparse[m_dense[index]] = index;
+		}
+		m_data.pop_back();
+		m_dense.pop_back();
+		m_sparse[id] = npos;
+	}
+
+	// room for extra more components, keeping the usual geometric growth
+	void reserve(size_t extra)
+	{
+		size_t wanted = m_data.size() + extra;
+		if (wanted <= m_data.capacity())
+			return;
+		wanted = std::max(wanted, m_data.capacity() * 2);
+		m_data.reserve(wanted);
+		m_dense.reserve(wanted);
+	}
+
+	size_t							size() const	{ return m_data.size(); }
+	std::vector<T>&					data()			{ return m_data; }
+	const std::vector<size_t>&		ids() const		{ return m_dense; }
+};
+
+
+template <typename Tuple> struct VariantOf;
+template <typename... Ts> struct VariantOf<std::tuple<Ts...>>
+{
+	using type = std::variant<Ts...>;
+};
+
+// any one component, for code that carries components around by value
+using ComponentVariant = typename VariantOf<ComponentTuple>::type;
+
+
+template <typename Tuple> struct PoolsOf;
+template <typename... Ts> struct PoolsOf<std::tuple<Ts...>>
+{
+	using type = std::tuple<ComponentPool<Ts>...>;
+};
+
+
+// one ComponentPool per component type, owned by the EntityManager,
+// plus a mask per entity id with one bit for each component it holds
+class ComponentStore
+{
+	typename PoolsOf<ComponentTuple>::type	m_pools;
+	std::vector<ComponentMask>				m_masks;
+
+	ComponentMask& maskOf(size_t id)
+	{
+		if (id >= m_masks.size())
+			m_masks.resize(id + 1, 0);
+		return m_masks[id];
+	}
+
+public:
+	// set once the entity has been moved out of the manager's pending list,
+	// views skip entities that are not live yet
+	static constexpr ComponentMask LiveBit{ ComponentMask(1) << 31 };
+
+	template <typename T>
+	ComponentPool<T>& pool()
+	{
+		return std::get<ComponentPool<T>>(m_pools);
+	}
+
+	template <typename T>
+	const ComponentPool<T>& pool() const
+	{
+		return std::get<ComponentPool<T>>(m_pools);
+	}
+
+	template <typename T>
+	T& add(size_t id, T&& component)
+	{
+		maskOf(id) |= componentMask<T>;
+		return pool<T>().add(id, std::move(component));
+	}
+
+	template <typename T>
+	void remove(size_t id)
+	{
+		maskOf(id) &= ~componentMask<T>;
+		pool<T>().remove(id);
+	}
+
+	// removes every component whose bit is set in mask
+	void remove(size_t id, ComponentMask mask)
+	{
+		std::apply([id, mask](auto&... pools) {
+			((mask & componentMask<typename std::decay_t<decltype(pools)>::value_type> ? pools.remove(id) : void()), ...);
+		}, m_pools);
+		maskOf(id) &= ~mask;
+	}
+
+	ComponentMask mask(size_t id) const
+	{
+		return id < m_masks.size() ? m_masks[id] : 0;
+	}
+
+	void markLive(size_t id)
+	{
+		maskOf(id) |= LiveBit;
+	}
+
+	void removeAll(size_t id)
+	{
+		std::apply([id](auto&... pools) { (pools.remove(id), ...); }, m_pools);
+		maskOf(id) = 0;
+	}
+};
@@ -75,6 +75,7 @@ struct CBoundingBox : public Component
 	Vec2 halfSize{ 0.f, 0.f };
 	bool someFlag{ false };
 	bool anotherFlag{ false };
+	bool swept{ false };		// fast mover, contacts are found by time of impact
 
 	CBoundingBox() = default;
 	CBoundingBox(const Vec2& s) : size(s), halfSize(0.5f * s) 
@@ -97,7 +98,7 @@ struct CTransform : public Component
 	float	angle{ 0.f };
 
 	CTransform() = default;
-	CTransform(const Vec2& p) : pos(p)  {}
+	CTransform(const Vec2& p) : pos(p), prevPos(p)  {}
 	CTransform(const Vec2& p, const Vec2& v, const Vec2& sc, float a) 
 		: pos(p), prevPos(p), vel(v), scale(sc), angle(a) {}
 
@@ -165,3 +166,27 @@ struct CPlatformInfo : public Component {
 	CPlatformInfo() = default;
 	CPlatformInfo(float startX, float endX) : platformStartX(startX), platformEndX(endX) {}
 };
+
+// How an entity moves. Entities without a body are static level pieces and
+// are never integrated. Kinematic bodies follow their velocity every step,
+// dynamic ones also fall asleep once they have been at rest for a while and
+// wake up as soon as they get a velocity or are moved.
+struct CBody : public Component
+{
+	enum Type { Kinematic, Dynamic };
+
+	Type	type{ Dynamic };
+	bool	asleep{ false };
+	int		restFrames{ 0 };	// steps in a row without moving
+
+	CBody() = default;
+	CBody(Type t) : type(t) {}
+};
+
+// Carried by every body that is not asleep, so movement only walks the
+// bodies that can move. Physics takes it away when a body falls asleep and
+// gives it back when the body wakes.
+struct CAwake : public Component
+{
+	CAwake() = default;
+};
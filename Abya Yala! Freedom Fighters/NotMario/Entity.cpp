@@ -1,11 +1,23 @@
 #include "Entity.h"
+#include "EntityManager.h"
+#include <stdexcept>
 
 const size_t& Entity::getId() const
 {
     return m_id;
 }
 
+EntityHandle Entity::getHandle() const
+{
+    return { static_cast<uint32_t>(m_id), m_generation };
+}
+
 const std::string& Entity::getTag() const
+{
+    return EntityManager::tagName(m_tag);
+}
+
+EntityTag Entity::getTagId() const
 {
     return m_tag;
 }
@@ -15,14 +27,26 @@ bool Entity::isActive() const
     return m_active;
 }
 
+void Entity::missingComponent(const std::type_info& component) const
+{
+    std::cerr << "Entity " << m_id << " (" << getTag() << ") has no " << component.name() << std::endl;
+    throw std::out_of_range(std::string("Entity has no ") + component.name());
+}
+
 void Entity::destroy()
 {
+    if (!m_active)
+        return;
     m_active = false;
+    m_manager->queueDestroy(this);
 }
 
-Entity::Entity(size_t id, const std::string& tag)
+Entity::Entity(size_t id, uint32_t generation, EntityTag tag, EntityManager& manager, ComponentStore& components)
     : m_tag(tag)
     , m_id(id)
+    , m_generation(generation)
+    , m_manager(&manager)
+    , m_components(&components)
 {
 
 }
@@ -3,58 +3,89 @@
 #include <string>
 #include <tuple>
 #include <memory>
+#include <typeinfo>
 #include "Components.h"
+#include "ComponentStore.h"
+#include "EntityHandle.h"
 
 // forward declarations
 class EntityManager;
 
-using ComponentTuple = std::tuple< CTransform, CLifespan,
-	CInput, CBoundingBox, CAnimation, CGravity, CState, CHealth, CPlatformInfo, CAttackTimer>;
-
 
 class Entity
 {
 private:
 	friend class EntityManager;
-	Entity(size_t id, const std::string& tag);  // create entities with EntityManager
+	Entity(size_t id, uint32_t generation, EntityTag tag, EntityManager& manager, ComponentStore& components);  // create entities with EntityManager
 	
 
-	const size_t				m_id{ 0 };
-	const std::string			m_tag{ "Default" };
+	const size_t				m_id{ 0 };				// slot index, reused after the entity is removed
+	const uint32_t				m_generation{ 0 };
+	const EntityTag				m_tag{ 0 };
 	bool						m_active{ true };
-	ComponentTuple				m_components;
+	size_t						m_index{ 0 };			// position in the manager's list of all entities
+	size_t						m_tagIndex{ 0 };		// position in the manager's list for m_tag
+	EntityManager*				m_manager{ nullptr };
+	ComponentStore*				m_components{ nullptr };	// owned by the EntityManager
+
+	[[noreturn]] void			missingComponent(const std::type_info& component) const;
 	
 public:
 	void						destroy();
 	const size_t&				getId() const;
+	EntityHandle				getHandle() const;
 	const std::string&			getTag() const;
+	EntityTag					getTagId() const;
 	bool						isActive() const;
 
 	template <typename T>
 	bool hasComponent() const
 	{
-		return getComponent<T>().has;
+		return hasComponents<T>();
+	}
+
+	template <typename... Ts>
+	bool hasComponents() const
+	{
+		constexpr ComponentMask mask = componentMask<Ts...>;
+		return (m_components->mask(m_id) & mask) == mask;
 	}
 
 	template <typename T, typename... TArgs>
 	T& addComponent(TArgs&&... mArgs)
 	{
-		auto& component = getComponent<T>();
-		component = T(std::forward<TArgs>(mArgs)...);
+		auto& component = m_components->add(m_id, T(std::forward<TArgs>(mArgs)...));
 		component.has = true;
 		return component;
 	}
 
+	template <typename T>
+	void removeComponent()
+	{
+		m_components->remove<T>(m_id);
+	}
+
+	void removeComponents(ComponentMask mask)
+	{
+		m_components->remove(m_id, mask);
+	}
+
+	// throws std::out_of_range if the entity does not have a T,
+	// check with hasComponent first when it may not
 	template<typename T>
 	T& getComponent()
 	{
-		return std::get<T>(m_components);
+		if (!hasComponent<T>())
+			missingComponent(typeid(T));
+		return m_components->pool<T>().get(m_id);
 	}
 
 	template<typename T>
 	const T& getComponent() const
 	{
-		return std::get<T>(m_components);
+		if (!hasComponent<T>())
+			missingComponent(typeid(T));
+		return m_components->pool<T>().get(m_id);
 	}
 
 };
@@ -0,0 +1,60 @@
+#include "EntityCommands.h"
+#include "EntityManager.h"
+#include "Entity.h"
+
+namespace {
+
+	void addPayload(Entity& entity, ComponentVariant& payload)
+	{
+		std::visit([&entity](auto& component) {
+			using T = std::decay_t<decltype(component)>;
+			entity.addComponent<T>(std::move(component));
+		}, payload);
+	}
+}
+
+void EntityCommands::playback(EntityManager& manager)
+{
+	for (auto& command : m_commands)
+	{
+		if (command.op == Op::Spawn)
+		{
+			auto entity = manager.addEntity(command.tag);
+			for (size_t i = command.first; i < command.first + command.count; ++i)
+				addPayload(*entity, m_payload[i]);
+			if (command.spawned)
+				*command.spawned = entity->getHandle();
+			continue;
+		}
+
+		if (command.op == Op::Instantiate)
+		{
+			auto entities = manager.instantiate(*command.prefab, 1, { &command.position, 1 });
+			if (command.spawned)
+				*command.spawned = entities[0]->getHandle();
+			continue;
+		}
+
+		auto entity = manager.get(command.target);
+		if (!entity || !entity->isActive())
+			continue;
+
+		switch (command.op)
+		{
+		case Op::Add:
+			addPayload(*entity, m_payload[command.first]);
+			break;
+		case Op::Remove:
+			entity->removeComponents(command.removed);
+			break;
+		case Op::Destroy:
+			entity->destroy();
+			break;
+		default:
+			break;
+		}
+	}
+
+	m_commands.clear();
+	m_payload.clear();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Common.h"
+#include "ComponentStore.h"
+#include "EntityHandle.h"
+#include "Prefab.h"
+#include <mutex>
+
+// forward declarations
+class EntityManager;
+
+
+// Structural changes recorded by systems while they iterate and played back
+// by the EntityManager at the start of its next update, so no entity list or
+// component pool changes under a running system.
+// Recording is safe from several threads at once, playback is not.
+class EntityCommands
+{
+	enum class Op { Spawn, Instantiate, Add, Remove, Destroy };
+
+	struct Command
+	{
+		Op				op;
+		EntityHandle	target;					// Add, Remove, Destroy
+		EntityTag		tag{ 0 };				// Spawn
+		EntityHandle*	spawned{ nullptr };		// Spawn, Instantiate: receives the new entity's handle
+		const Prefab*	prefab{ nullptr };		// Instantiate
+		Vec2			position{ 0.f, 0.f };	// Instantiate
+		size_t			first{ 0 };				// Spawn, Add: components in m_payload
+		size_t			count{ 0 };
+		ComponentMask	removed{ 0 };			// Remove
+	};
+
+	std::vector<Command>			m_commands;
+	std::vector<ComponentVariant>	m_payload;
+	std::mutex						m_mutex;
+
+	template <typename... Cs>
+	void record(EntityHandle* spawned, EntityTag tag, Cs&&... components)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_commands.push_back({ Op::Spawn, {}, tag, spawned, nullptr, {}, m_payload.size(), sizeof...(Cs) });
+		(m_payload.emplace_back(std::forward<Cs>(components)), ...);
+	}
+
+public:
+	EntityCommands() = default;
+	EntityCommands(EntityCommands&& other) noexcept
+		: m_commands(std::move(other.m_commands)), m_payload(std::move(other.m_payload)) {}
+
+	EntityCommands& operator=(EntityCommands&& other) noexcept
+	{
+		m_commands = std::move(other.m_commands);
+		m_payload = std::move(other.m_payload);
+		return *this;
+	}
+
+	// spawn(Tag::Key, CAnimation(...), CTransform(pos), CBoundingBox(size))
+	template <typename... Cs>
+	void spawn(EntityTag tag, Cs&&... components)
+	{
+		record(nullptr, tag, std::forward<Cs>(components)...);
+	}
+
+	// as above, handle is written once the entity exists
+	template <typename... Cs>
+	void spawn(EntityHandle& handle, EntityTag tag, Cs&&... components)
+	{
+		record(&handle, tag, std::forward<Cs>(components)...);
+	}
+
+	// one entity stamped from a prefab, the prefab has to outlive playback
+	void instantiate(const Prefab& prefab, const Vec2& position, EntityHandle* handle = nullptr)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_commands.push_back({ Op::Instantiate, {}, prefab.tag, handle, &prefab, position });
+	}
+
+	template <typename T>
+	void add(EntityHandle target, T&& component)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_commands.push_back({ Op::Add, target, 0, nullptr, nullptr, {}, m_payload.size(), 1 });
+		m_payload.emplace_back(std::forward<T>(component));
+	}
+
+	template <typename... Ts>
+	void remove(EntityHandle target)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_commands.push_back({ Op::Remove, target });
+		m_commands.back().removed = componentMask<Ts...>;
+	}
+
+	void destroy(EntityHandle target)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_commands.push_back({ Op::Destroy, target });
+	}
+
+	bool empty() const { return m_commands.empty(); }
+
+	// applies every command in recording order, commands aimed at entities
+	// that are gone or destroyed are dropped
+	void playback(EntityManager& manager);
+};
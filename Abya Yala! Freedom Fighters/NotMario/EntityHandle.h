@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <compare>
+
+// Weak reference to an entity: a slot index plus the generation of the
+// entity living in that slot. EntityManager::get returns nullptr once the
+// entity is gone, even after its slot has been reused.
+struct EntityHandle
+{
+	static constexpr uint32_t invalidIndex{ UINT32_MAX };
+
+	uint32_t	index{ invalidIndex };
+	uint32_t	generation{ 0 };
+
+	bool isValid() const { return index != invalidIndex; }
+
+	auto operator<=>(const EntityHandle&) const = default;
+};
@@ -2,25 +2,204 @@
 #include "Entity.h"
 
 #include <algorithm>
+#include <deque>
+#include <new>
 #include <ranges>
+#include <unordered_map>
+
+namespace {
+
+	// systems may intern tags from worker threads, names is a deque so the
+	// references handed out by tagName stay valid as it grows
+	struct TagRegistry
+	{
+		std::mutex									mutex;
+		std::unordered_map<std::string, EntityTag>	ids;
+		std::deque<std::string>						names;
+	};
+
+	TagRegistry& tagRegistry()
+	{
+		static TagRegistry registry;
+		return registry;
+	}
+
+	// keeps the usual doubling, so asking for one more at a time does not
+	// reallocate on every call
+	template <typename T>
+	void reserveAtLeast(std::vector<T>& v, size_t count)
+	{
+		if (count > v.capacity())
+			v.reserve(std::max(count, v.capacity() * 2));
+	}
+}
 
 EntityManager::EntityManager()
-	: m_totalEntities(0)
+	: m_components(std::make_unique<ComponentStore>())
 {}
 
-std::shared_ptr<Entity> EntityManager::addEntity(const std::string& tag)
+// entities point back at their manager, so a move has to rebind them
+EntityManager::EntityManager(EntityManager&& other) noexcept
+	: m_entities(std::move(other.m_entities))
+	, m_entityMap(std::move(other.m_entityMap))
+	, m_EntitiesToAdd(std::move(other.m_EntitiesToAdd))
+	, m_EntitiesToDestroy(std::move(other.m_EntitiesToDestroy))
+	, m_commands(std::move(other.m_commands))
+	, m_version(other.m_version)
+	, m_tagVersions(std::move(other.m_tagVersions))
+	, m_slabs(std::move(other.m_slabs))
+	, m_slots(std::move(other.m_slots))
+	, m_generations(std::move(other.m_generations))
+	, m_freeSlots(std::move(other.m_freeSlots))
+	, m_components(std::move(other.m_components))
+{
+	rebindEntities();
+}
+
+EntityManager& EntityManager::operator=(EntityManager&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	destroyAll();
+	m_entities = std::move(other.m_entities);
+	m_entityMap = std::move(other.m_entityMap);
+	m_EntitiesToAdd = std::move(other.m_EntitiesToAdd);
+	m_EntitiesToDestroy = std::move(other.m_EntitiesToDestroy);
+	m_commands = std::move(other.m_commands);
+	m_version = other.m_version;
+	m_tagVersions = std::move(other.m_tagVersions);
+	m_slabs = std::move(other.m_slabs);
+	m_slots = std::move(other.m_slots);
+	m_generations = std::move(other.m_generations);
+	m_freeSlots = std::move(other.m_freeSlots);
+	m_components = std::move(other.m_components);
+	rebindEntities();
+	return *this;
+}
+
+EntityManager::~EntityManager()
+{
+	destroyAll();
+}
+
+EntityTag EntityManager::tagId(const std::string& tag)
+{
+	auto& registry = tagRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	auto [it, inserted] = registry.ids.try_emplace(tag, registry.names.size());
+	if (inserted)
+		registry.names.push_back(tag);
+	return it->second;
+}
+
+const std::string& EntityManager::tagName(EntityTag id)
+{
+	auto& registry = tagRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	return registry.names.at(id);
+}
+
+Entity* EntityManager::addEntity(const std::string& tag)
 {
-	// create a new Entity object
-	auto entity = std::shared_ptr<Entity>(new Entity(m_totalEntities++, tag));
+	return addEntity(tagId(tag));
+}
+
+Entity* EntityManager::addEntity(EntityTag tag)
+{
+	// reuse a free slot if there is one
+	uint32_t index;
+	if (!m_freeSlots.empty())
+	{
+		index = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_slots.size());
+		if (index / SlabSize == m_slabs.size())
+			m_slabs.push_back(std::make_unique<std::byte[]>(SlabSize * sizeof(Entity)));
+		m_slots.push_back(nullptr);
+		m_generations.push_back(0);
+	}
+
+	// construct the Entity in place inside its slab
+	auto entity = new (slotAddress(index)) Entity(index, m_generations[index], tag, *this, *m_components);
+	m_slots[index] = entity;
 
 	// store it in entities vector
 	m_EntitiesToAdd.push_back(entity);
 
-	// return shared pointer to it 
 	return entity;
 }
 
 
+Entity* EntityManager::get(EntityHandle handle) const
+{
+	if (handle.index >= m_slots.size() || m_generations[handle.index] != handle.generation)
+		return nullptr;
+	return m_slots[handle.index];
+}
+
+
+std::span<Entity* const> EntityManager::addEntities(size_t count, EntityTag tag)
+{
+	reserve(m_slots.size() - m_freeSlots.size() + count);
+	reserveAtLeast(m_EntitiesToAdd, m_EntitiesToAdd.size() + count);
+
+	for (size_t i = 0; i < count; ++i)
+		addEntity(tag);
+
+	return { m_EntitiesToAdd.data() + m_EntitiesToAdd.size() - count, count };
+}
+
+
+std::span<Entity* const> EntityManager::instantiate(const Prefab& prefab, size_t count, std::span<const Vec2> positions)
+{
+	auto entities = addEntities(count, prefab.tag);
+
+	// one pass per component type, copying the template into every entity
+	for (const auto& component : prefab.components)
+	{
+		std::visit([this, entities](const auto& value) {
+			using T = std::decay_t<decltype(value)>;
+			m_components->pool<T>().reserve(entities.size());
+			for (auto e : entities)
+				e->addComponent<T>(value);
+		}, component);
+	}
+
+	for (size_t i = 0; i < positions.size() && i < count; ++i)
+	{
+		auto e = entities[i];
+		if (e->hasComponent<CTransform>())
+			e->getComponent<CTransform>().pos = e->getComponent<CTransform>().prevPos = positions[i];
+		else
+			e->addComponent<CTransform>(positions[i]);
+	}
+
+	return entities;
+}
+
+
+void EntityManager::reserve(size_t count)
+{
+	while (m_slabs.size() * SlabSize < count)
+		m_slabs.push_back(std::make_unique<std::byte[]>(SlabSize * sizeof(Entity)));
+
+	reserveAtLeast(m_slots, count);
+	reserveAtLeast(m_generations, count);
+	reserveAtLeast(m_freeSlots, count);
+	reserveAtLeast(m_entities, count);
+}
+
+
+EntityCommands& EntityManager::commands()
+{
+	return m_commands;
+}
+
+
 EntityVec& EntityManager::getEntities()
 {
 	return m_entities;
@@ -29,29 +208,121 @@ EntityVec& EntityManager::getEntities()
 
 EntityVec& EntityManager::getEntities(const std::string& tag)
 {
+	return getEntities(tagId(tag));
+}
+
+
+EntityVec& EntityManager::getEntities(EntityTag tag)
+{
+	// grow to cover every tag interned so far; the map is a deque, so the
+	// lists already handed out keep their addresses
+	if (tag >= m_entityMap.size())
+	{
+		auto& registry = tagRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		m_entityMap.resize(registry.names.size());
+	}
 	return m_entityMap[tag];
 }
 
 
-void EntityManager::removeDeadEntities(EntityVec& v)
+void EntityManager::queueDestroy(Entity* e)
 {
-	v.erase(std::remove_if(v.begin(), v.end(), [](auto e) {return!(e->isActive()); }), v.end());
+	std::lock_guard<std::mutex> lock(m_destroyMutex);
+	m_EntitiesToDestroy.push_back(e);
 }
 
 
-void EntityManager::update()
+void EntityManager::removeFromLists(Entity* e)
 {
-	// Remove dead entities 
-	removeDeadEntities(m_entities);
-	for (auto& [_, entityVec] : m_entityMap)
-		removeDeadEntities(entityVec);
+	// the lists are unordered, move the last entity into the hole
+	auto last = m_entities.back();
+	m_entities[e->m_index] = last;
+	last->m_index = e->m_index;
+	m_entities.pop_back();
+
+	auto& entityVec = m_entityMap[e->m_tag];
+	last = entityVec.back();
+	entityVec[e->m_tagIndex] = last;
+	last->m_tagIndex = e->m_tagIndex;
+	entityVec.pop_back();
+}
 
 
+void EntityManager::freeSlot(Entity* e)
+{
+	auto index = e->getHandle().index;
+	m_components->removeAll(index);
+	++m_generations[index];
+	m_freeSlots.push_back(index);
+	m_slots[index] = nullptr;
+	e->~Entity();
+}
+
+
+Entity* EntityManager::slotAddress(uint32_t index) const
+{
+	static_assert(alignof(Entity) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+	return reinterpret_cast<Entity*>(m_slabs[index / SlabSize].get() + (index % SlabSize) * sizeof(Entity));
+}
+
+
+void EntityManager::rebindEntities()
+{
+	for (auto e : m_slots)
+		if (e)
+			e->m_manager = this;
+}
+
+
+void EntityManager::destroyAll()
+{
+	for (auto e : m_slots)
+		if (e)
+			e->~Entity();
+	m_slots.clear();
+}
+
+
+void EntityManager::bumpVersion(EntityTag tag)
+{
+	if (tag >= m_tagVersions.size())
+		m_tagVersions.resize(tag + 1, 0);
+	++m_tagVersions[tag];
+	++m_version;
+}
+
+void EntityManager::update()
+{
+	if (!m_commands.empty())
+		m_commands.playback(*this);
+
 	// add new entities
 	for (auto e : m_EntitiesToAdd)
 	{
+		m_components->markLive(e->m_id);
+		e->m_index = m_entities.size();
 		m_entities.push_back(e);
-		m_entityMap[e->getTag()].push_back(e);
+		auto& entityVec = getEntities(e->getTagId());
+		e->m_tagIndex = entityVec.size();
+		entityVec.push_back(e);
+		bumpVersion(e->getTagId());
 	}
 	m_EntitiesToAdd.clear();
+
+	// nothing was destroyed since the last update
+	if (m_EntitiesToDestroy.empty())
+		return;
+
+	// systems running on several threads queue in any order, sort so the
+	// lists come out the same every run; only the dead are touched, the
+	// rest of the level stays where it is
+	std::sort(m_EntitiesToDestroy.begin(), m_EntitiesToDestroy.end(), [](auto a, auto b) { return a->m_id < b->m_id; });
+	for (auto e : m_EntitiesToDestroy)
+	{
+		removeFromLists(e);
+		bumpVersion(e->getTagId());
+		freeSlot(e);
+	}
+	m_EntitiesToDestroy.clear();
 }
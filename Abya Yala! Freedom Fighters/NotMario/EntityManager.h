@@ -1,32 +1,182 @@
 #pragma once
 
 #include "Common.h"
+#include "ComponentStore.h"
+#include "EntityCommands.h"
+#include "EntityHandle.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <deque>
 #include <map>
+#include <mutex>
+#include <span>
 
 //forwared declare
 class Entity;
 
 
-using sPtrEntt = std::shared_ptr<Entity>;
-using EntityVec = std::vector<std::shared_ptr<Entity>>;
-using EntityMap = std::map <std::string, EntityVec>;
+using EntityVec = std::vector<Entity*>;
+using EntityMap = std::deque<EntityVec>;		// indexed by interned tag id, grows without moving the lists
+
+
+// Live entities holding every component in Ts, with those components resolved.
+// Walks the smallest of the pools and tests each entity's component mask,
+// so only entities that can match are visited.
+// Adding or removing components while iterating invalidates the view.
+template <typename... Ts>
+class EntityView
+{
+	static constexpr ComponentMask mask = componentMask<Ts...> | ComponentStore::LiveBit;
+
+	ComponentStore*				m_components;
+	const EntityVec*			m_slots;
+	const std::vector<size_t>*	m_ids{ nullptr };	// ids of the smallest pool
+
+public:
+	using value_type = std::tuple<Entity*, Ts&...>;
+
+	class iterator
+	{
+		const EntityView*	m_view;
+		size_t				m_index;
+
+		void skip()
+		{
+			const auto& ids = *m_view->m_ids;
+			while (m_index < ids.size() && (m_view->m_components->mask(ids[m_index]) & mask) != mask)
+				++m_index;
+		}
+
+	public:
+		iterator(const EntityView* view, size_t index) : m_view(view), m_index(index) { skip(); }
+
+		value_type operator*() const
+		{
+			size_t id = (*m_view->m_ids)[m_index];
+			return { (*m_view->m_slots)[id], m_view->m_components->template pool<Ts>().get(id)... };
+		}
+
+		iterator& operator++()		{ ++m_index; skip(); return *this; }
+		bool operator==(const iterator& other) const { return m_index == other.m_index; }
+	};
+
+	EntityView(ComponentStore& components, const EntityVec& slots)
+		: m_components(&components), m_slots(&slots)
+	{
+		((m_ids = (!m_ids || components.pool<Ts>().size() < m_ids->size()) ? &components.pool<Ts>().ids() : m_ids), ...);
+	}
+
+	iterator begin() const	{ return { this, 0 }; }
+	iterator end() const	{ return { this, m_ids->size() }; }
+
+	// the view splits into [at(i), at(j)) ranges over the driving pool,
+	// which is how parallelEach hands it out in chunks
+	iterator at(size_t index) const	{ return { this, index }; }
+	size_t extent() const			{ return m_ids->size(); }
+};
 
 class EntityManager
 {
 private:
+	friend class Entity;
+
 	EntityVec	m_entities;
 	EntityMap	m_entityMap;
-	size_t		m_totalEntities{0};
 	EntityVec	m_EntitiesToAdd;
+	EntityVec	m_EntitiesToDestroy;	// queued by Entity::destroy, applied in update
+	std::mutex	m_destroyMutex;
+	EntityCommands	m_commands;
+	uint64_t				m_version{ 0 };
+	std::vector<uint64_t>	m_tagVersions;		// indexed by interned tag id
+
+	// entities live in fixed size slabs so their addresses never move, a
+	// slot's generation is bumped when its entity is removed and the slot is
+	// handed out again from m_freeSlots
+	static constexpr size_t SlabSize{ 256 };
+	std::vector<std::unique_ptr<std::byte[]>>	m_slabs;
+	std::vector<Entity*>					m_slots;		// nullptr while the slot is free
+	std::vector<uint32_t>					m_generations;
+	std::vector<uint32_t>					m_freeSlots;
+	std::unique_ptr<ComponentStore>			m_components;	// heap owned so entities keep a stable pointer
 
-	void		removeDeadEntities(EntityVec& v);
+	void		queueDestroy(Entity* e);
+	void		removeFromLists(Entity* e);
+	void		freeSlot(Entity* e);
+	void		rebindEntities();
+	void		bumpVersion(EntityTag tag);
+	void		destroyAll();
+	Entity*		slotAddress(uint32_t index) const;
 
 public:
 	EntityManager();
+	EntityManager(EntityManager&&) noexcept;
+	EntityManager& operator=(EntityManager&&) noexcept;
+	~EntityManager();
+
+	// tags are interned once into small ids shared by every EntityManager
+	static EntityTag			tagId(const std::string& tag);
+	static const std::string&	tagName(EntityTag id);
 
-	std::shared_ptr<Entity> addEntity(const std::string& tag);
-	EntityVec& getEntities(); 
+	Entity* addEntity(const std::string& tag);
+	Entity* addEntity(EntityTag tag);
+	// the returned span points into the pending list and is only valid until
+	// the next addEntity or update
+	std::span<Entity* const> addEntities(size_t count, EntityTag tag);
+	void	reserve(size_t count);		// room for count live entities without allocating
+	// count copies of prefab, positions (if given) are written to each
+	// copy's transform; same lifetime as the span from addEntities
+	std::span<Entity* const> instantiate(const Prefab& prefab, size_t count, std::span<const Vec2> positions = {});
+	Entity* get(EntityHandle handle) const;		// nullptr if the entity is gone
+	EntityCommands& commands();		// played back at the start of update
+	EntityVec& getEntities(); 		// every live entity, in no particular order
 	EntityVec& getEntities(const std::string& tag);
+	EntityVec& getEntities(EntityTag tag);
+
+	// bumped by update() for every entity added or removed, overall and per
+	// tag, so anything built from the entity lists can tell it is stale
+	uint64_t	version() const { return m_version; }
+	uint64_t	version(EntityTag tag) const { return tag < m_tagVersions.size() ? m_tagVersions[tag] : 0; }
+
+	template <typename T>
+	ComponentPool<T>& getComponentPool()
+	{
+		return m_components->pool<T>();
+	}
+
+	// for (auto [e, transform, box] : view<CTransform, CBoundingBox>())
+	template <typename... Ts>
+	EntityView<Ts...> view()
+	{
+		static_assert(sizeof...(Ts) > 0, "a view needs at least one component");
+		return { *m_components, m_slots };
+	}
+
+	// calls fn(Entity*, Ts&...) for every entity in view<Ts...>()
+	template <typename... Ts, typename F>
+	void each(F&& fn)
+	{
+		for (auto components : view<Ts...>())
+			std::apply(fn, components);
+	}
+
+	// each<Ts...>(fn) in chunks of grain entities spread over the pool,
+	// fn may only touch the components of the entity it is given.
+	// Deterministic builds run it as each<Ts...>(fn) on the calling thread
+	template <typename... Ts, typename F>
+	void parallelEach(ThreadPool& threads, size_t grain, F&& fn)
+	{
+		if constexpr (Deterministic)
+		{
+			each<Ts...>(fn);
+			return;
+		}
+
+		auto entities = view<Ts...>();
+		threads.parallelFor(entities.extent(), grain, [&entities, &fn](size_t begin, size_t end) {
+			for (auto it = entities.at(begin), last = entities.at(end); it != last; ++it)
+				std::apply(fn, *it);
+		});
+	}
 	
 	void update();
 };
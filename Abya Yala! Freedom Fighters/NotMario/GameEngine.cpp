@@ -14,6 +14,7 @@ GameEngine::GameEngine(const std::string& path)
 
 void GameEngine::init(const std::string& path)
 {
+	loadSettings(path);
 	m_assets.loadFromFile(path);
 
     m_window.create(sf::VideoMode(1280, 768), "Not Mario");
@@ -23,6 +24,29 @@ void GameEngine::init(const std::string& path)
 	changeScene("MENU", std::make_shared<Scene_Menu>(this));
 }
 
+// Window width height rate fullscreen
+// only the rate is used, it sets the simulation steps per second. The window
+// is always created at 1280x768
+void GameEngine::loadSettings(const std::string& path)
+{
+	std::ifstream confFile(path);
+	std::string token;
+	while (confFile >> token)
+	{
+		if (token == "Window")
+		{
+			int width, height, fullscreen;
+			float rate;
+			if (confFile >> width >> height >> rate >> fullscreen && rate > 0)
+				setSimulationRate(rate);
+			else
+				std::cerr << "Bad Window line in " << path << ", keeping " << 1.f / StepSeconds << " steps per second\n";
+			return;
+		}
+		std::getline(confFile, token);
+	}
+}
+
 void GameEngine::update()
 {
 
@@ -76,13 +100,12 @@ void GameEngine::quit()
 void GameEngine::run()
 {
 
-	const sf::Time SPF = sf::seconds(1.0f / 60.f);  // Fixed update time step (60 FPS)
-
 	sf::Clock clock;
 	sf::Time timeSinceLastUpdate = sf::Time::Zero;
 
 	while (isRunning())
 	{
+		const sf::Time SPF = sf::seconds(m_stepSeconds);  // Fixed update time step (60 FPS by default)
 		timeSinceLastUpdate += clock.restart(); // Get time elapsed since last frame
 
 		while (timeSinceLastUpdate > SPF)  // Ensure fixed time step
@@ -95,6 +118,8 @@ void GameEngine::run()
 			timeSinceLastUpdate -= SPF;
 		}
 
+		// the leftover time places this frame between the last two steps
+		m_renderAlpha = timeSinceLastUpdate / SPF;
 		currentScene()->sRender();  // Render world
 	}
 }
@@ -111,6 +136,11 @@ const Assets& GameEngine::assets() const
 	return m_assets;
 }
 
+ThreadPool& GameEngine::threads()
+{
+	return m_threads;
+}
+
 
 bool GameEngine::isRunning()
 {
@@ -3,6 +3,7 @@
 #include "Common.h"
  
 #include "Assets.h"
+#include "ThreadPool.h"
 
 #include <memory>
 #include <map>
@@ -22,11 +23,16 @@ public:
 	size_t				m_simulationSpeed{ 1 };
 	bool				m_running{ true };
 	float               m_deltaTime = 0.0f;
+	static constexpr float StepSeconds{ 1.0f / 60.f };	// default fixed update
+	float				m_stepSeconds{ StepSeconds };
+	float				m_renderAlpha{ 1.f };
 	sf::Clock m_clock;
+	ThreadPool			m_threads;
 
 
 public:
 	void init(const std::string& path);
+	void loadSettings(const std::string& path);
 	void update();
 
 	void sUserInput();
@@ -45,13 +51,24 @@ public:
 
 	sf::RenderWindow& window();
 	const Assets& assets() const;
+	ThreadPool& threads();
 	bool isRunning();
 
+	// a deterministic build pretends every step took exactly one step
 	void updateDeltaTime() {
 		m_deltaTime = m_clock.restart().asSeconds();
+		if constexpr (Deterministic)
+			m_deltaTime = m_stepSeconds;
 	}
 
 	float deltaTime() const { return m_deltaTime; }
 
+	// simulation steps per second, rendering still runs as fast as it can
+	void setSimulationRate(float hz) { m_stepSeconds = 1.f / hz; }
+
+	// how far the frame being drawn is between the last two simulation
+	// steps, 0 at the previous one and 1 at the latest
+	float renderAlpha() const { return m_renderAlpha; }
+
 };
 
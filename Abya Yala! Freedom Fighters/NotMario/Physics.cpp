@@ -1,15 +1,189 @@
 #include "Physics.h"
+#include "EntityManager.h"
+#include <algorithm>
+#include <climits>
 #include <cmath>
+#include <limits>
 
-Vec2 Physics::getOverlap(std::shared_ptr<Entity> a, std::shared_ptr<Entity> b) {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PHYSICS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PHYSICS_TARGET(isa)
+#else
+#define PHYSICS_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+bool Physics::AABB::overlaps(const AABB& other) const {
+    return min.x < other.max.x && other.min.x < max.x
+        && min.y < other.max.y && other.min.y < max.y;
+}
+
+Physics::AABB Physics::AABB::expanded(const Vec2& margin) const {
+    return { Vec2(min.x - margin.x, min.y - margin.y), Vec2(max.x + margin.x, max.y + margin.y) };
+}
+
+Vec2 Physics::AABB::center() const {
+    return Vec2((min.x + max.x) / 2.f, (min.y + max.y) / 2.f);
+}
+
+Vec2 Physics::AABB::halfSize() const {
+    return Vec2((max.x - min.x) / 2.f, (max.y - min.y) / 2.f);
+}
+
+Physics::AABB Physics::getAABB(const Entity& e) {
+    auto& tx = e.getComponent<CTransform>();
+    auto& bb = e.getComponent<CBoundingBox>();
+    return { Vec2(tx.pos.x - bb.halfSize.x, tx.pos.y - bb.halfSize.y),
+             Vec2(tx.pos.x + bb.halfSize.x, tx.pos.y + bb.halfSize.y) };
+}
+
+namespace {
+
+    bool resting(const CTransform& tx, bool supported = false) {
+        using Physics::RestSpeed;
+        return std::abs(tx.vel.x) < RestSpeed && (supported || std::abs(tx.vel.y) < RestSpeed)
+            && std::abs(tx.pos.x - tx.prevPos.x) < RestSpeed && std::abs(tx.pos.y - tx.prevPos.y) < RestSpeed;
+    }
+}
+
+bool Physics::integrate(CBody& body, CTransform& tx, bool supported) {
+    bool fellAsleep = false;
+    if (body.type == CBody::Dynamic) {
+        if (!resting(tx, supported)) {
+            body.restFrames = 0;
+            body.asleep = false;
+        }
+        else if (body.restFrames < SleepFrames && ++body.restFrames == SleepFrames) {
+            // the gravity of this step goes into whatever holds it up
+            tx.vel.y = 0.f;
+            body.asleep = true;
+            fellAsleep = true;
+        }
+    }
+
+    if (body.asleep)
+        return fellAsleep;
+    tx.prevPos = tx.pos;
+    tx.pos += tx.vel;
+    return false;
+}
+
+void Physics::wake(Entity& e, EntityCommands& commands) {
+    auto& body = e.getComponent<CBody>();
+    if (!body.asleep || resting(e.getComponent<CTransform>()))
+        return;
+
+    // recorded after any removal from the step it fell asleep, so playback
+    // leaves it awake either way
+    body.asleep = false;
+    body.restFrames = 0;
+    commands.add(e.getHandle(), CAwake());
+}
+
+bool Physics::isAsleep(const Entity& e) {
+    return e.hasComponent<CBody>() && e.getComponent<CBody>().asleep;
+}
+
+bool Physics::segmentHit(const Vec2& from, const Vec2& delta, const AABB& box, float& t, Vec2& normal) {
+    float tEnter = 0.f, tExit = t;
+    Vec2 enterNormal;
+
+    // a segment parallel to a slab has to run strictly inside it, grazing
+    // a face is not a hit
+    auto slab = [&](float start, float d, float min, float max, const Vec2& axis) {
+        if (d == 0.f)
+            return start > min && start < max;
+        float t0 = (min - start) / d, t1 = (max - start) / d;
+        if (t0 > t1)
+            std::swap(t0, t1);
+        if (t0 > tEnter) {
+            tEnter = t0;
+            enterNormal = d > 0.f ? Vec2(-axis.x, -axis.y) : axis;
+        }
+        tExit = std::min(tExit, t1);
+        return tEnter < tExit;
+    };
+
+    if (!slab(from.x, delta.x, box.min.x, box.max.x, Vec2(1.f, 0.f))
+        || !slab(from.y, delta.y, box.min.y, box.max.y, Vec2(0.f, 1.f))
+        || tEnter >= t)
+        return false;
+
+    t = tEnter;
+    normal = enterNormal;
+    return true;
+}
+
+Physics::AABB Physics::getSweptAABB(const Entity& e) {
+    auto& tx = e.getComponent<CTransform>();
+    auto& bb = e.getComponent<CBoundingBox>();
+    return { Vec2(std::min(tx.pos.x, tx.prevPos.x) - bb.halfSize.x, std::min(tx.pos.y, tx.prevPos.y) - bb.halfSize.y),
+             Vec2(std::max(tx.pos.x, tx.prevPos.x) + bb.halfSize.x, std::max(tx.pos.y, tx.prevPos.y) + bb.halfSize.y) };
+}
+
+namespace {
+
+    // b held still with a carrying the relative motion, a shrunk to its centre
+    // and b grown by a's half size, so the centre traces a ray; offset is a's
+    // centre relative to b's at the start of the step, reach the grown half size
+    float sweepTime(const Vec2& offset, const Vec2& motion, const Vec2& reach) {
+        float enter = 0.f, exit = 1.f;
+        auto slab = [&](float start, float move, float half) {
+            if (move == 0.f)
+                return std::abs(start) < half;
+            float t0 = (-half - start) / move;
+            float t1 = (half - start) / move;
+            if (t0 > t1)
+                std::swap(t0, t1);
+            enter = std::max(enter, t0);
+            exit = std::min(exit, t1);
+            return enter < exit;
+        };
+
+        bool hit = slab(offset.x, motion.x, reach.x) && slab(offset.y, motion.y, reach.y);
+        return hit ? enter : -1.f;
+    }
+}
+
+float Physics::timeOfImpact(const Entity& a, const Entity& b) {
+    if (!a.hasComponents<CTransform, CBoundingBox>() or !b.hasComponents<CTransform, CBoundingBox>())
+        return -1.f;
+
+    auto& atx = a.getComponent<CTransform>();
+    auto& abb = a.getComponent<CBoundingBox>();
+    auto& btx = b.getComponent<CTransform>();
+    auto& bbb = b.getComponent<CBoundingBox>();
+
+    return sweepTime(Vec2(atx.prevPos.x - btx.prevPos.x, atx.prevPos.y - btx.prevPos.y),
+                     Vec2((atx.pos.x - atx.prevPos.x) - (btx.pos.x - btx.prevPos.x), (atx.pos.y - atx.prevPos.y) - (btx.pos.y - btx.prevPos.y)),
+                     Vec2(abb.halfSize.x + bbb.halfSize.x, abb.halfSize.y + bbb.halfSize.y));
+}
+
+float Physics::timeOfImpact(const Entity& a, const AABB& b) {
+    if (!a.hasComponents<CTransform, CBoundingBox>())
+        return -1.f;
+
+    auto& atx = a.getComponent<CTransform>();
+    auto& abb = a.getComponent<CBoundingBox>();
+    Vec2 center = b.center(), half = b.halfSize();
+
+    return sweepTime(Vec2(atx.prevPos.x - center.x, atx.prevPos.y - center.y),
+                     Vec2(atx.pos.x - atx.prevPos.x, atx.pos.y - atx.prevPos.y),
+                     Vec2(abb.halfSize.x + half.x, abb.halfSize.y + half.y));
+}
+
+Vec2 Physics::getOverlap(const Entity& a, const Entity& b) {
     Vec2 overlap(0.f, 0.f);
-    if (!a->hasComponent<CBoundingBox>() or !b->hasComponent<CBoundingBox>())
+    if (!a.hasComponents<CTransform, CBoundingBox>() or !b.hasComponents<CTransform, CBoundingBox>())
         return overlap;
 
-    auto atx = a->getComponent<CTransform>();
-    auto abb = a->getComponent<CBoundingBox>();
-    auto btx = b->getComponent<CTransform>();
-    auto bbb = b->getComponent<CBoundingBox>();
+    auto& atx = a.getComponent<CTransform>();
+    auto& abb = a.getComponent<CBoundingBox>();
+    auto& btx = b.getComponent<CTransform>();
+    auto& bbb = b.getComponent<CBoundingBox>();
 
     float dx = std::abs(atx.pos.x - btx.pos.x);
     float dy = std::abs(atx.pos.y - btx.pos.y);
@@ -19,15 +193,15 @@ Vec2 Physics::getOverlap(std::shared_ptr<Entity> a, std::shared_ptr<Entity> b) {
 
 }
 
-Vec2 Physics::getPreviousOverlap(std::shared_ptr<Entity> a, std::shared_ptr<Entity> b) {
+Vec2 Physics::getPreviousOverlap(const Entity& a, const Entity& b) {
     Vec2 overlap(0.f, 0.f);
-    if (!a->hasComponent<CBoundingBox>() or !b->hasComponent<CBoundingBox>())
+    if (!a.hasComponents<CTransform, CBoundingBox>() or !b.hasComponents<CTransform, CBoundingBox>())
         return overlap;
 
-    auto atx = a->getComponent<CTransform>();
-    auto abb = a->getComponent<CBoundingBox>();
-    auto btx = b->getComponent<CTransform>();
-    auto bbb = b->getComponent<CBoundingBox>();
+    auto& atx = a.getComponent<CTransform>();
+    auto& abb = a.getComponent<CBoundingBox>();
+    auto& btx = b.getComponent<CTransform>();
+    auto& bbb = b.getComponent<CBoundingBox>();
 
     if (abb.has && bbb.has) {
         float dx = std::abs(atx.prevPos.x - btx.prevPos.x);
@@ -36,3 +210,792 @@ Vec2 Physics::getPreviousOverlap(std::shared_ptr<Entity> a, std::shared_ptr<Enti
     }
     return overlap;
 }
+
+Vec2 Physics::getOverlap(const Entity& a, const AABB& b) {
+    Vec2 overlap(0.f, 0.f);
+    if (!a.hasComponents<CTransform, CBoundingBox>())
+        return overlap;
+
+    auto& atx = a.getComponent<CTransform>();
+    auto& abb = a.getComponent<CBoundingBox>();
+    Vec2 center = b.center(), half = b.halfSize();
+
+    float dx = std::abs(atx.pos.x - center.x);
+    float dy = std::abs(atx.pos.y - center.y);
+    return Vec2(abb.halfSize.x + half.x - dx, abb.halfSize.y + half.y - dy);
+}
+
+// terrain does not move, so only a's previous position changes
+Vec2 Physics::getPreviousOverlap(const Entity& a, const AABB& b) {
+    Vec2 overlap(0.f, 0.f);
+    if (!a.hasComponents<CTransform, CBoundingBox>())
+        return overlap;
+
+    auto& atx = a.getComponent<CTransform>();
+    auto& abb = a.getComponent<CBoundingBox>();
+    if (!abb.has)
+        return overlap;
+    Vec2 center = b.center(), half = b.halfSize();
+
+    float dx = std::abs(atx.prevPos.x - center.x);
+    float dy = std::abs(atx.prevPos.y - center.y);
+    return Vec2(abb.halfSize.x + half.x - dx, abb.halfSize.y + half.y - dy);
+}
+
+
+
+void Physics::BoxBatch::clear() {
+    centerX.clear(); centerY.clear();
+    prevX.clear(); prevY.clear();
+    halfX.clear(); halfY.clear();
+    id.clear();
+}
+
+void Physics::BoxBatch::push(const AABB& box, uint32_t boxId) {
+    Vec2 center = box.center();
+    push(center, center, box.halfSize(), boxId);
+}
+
+void Physics::BoxBatch::push(const Vec2& center, const Vec2& prevCenter, const Vec2& halfSize, uint32_t boxId) {
+    centerX.push_back(center.x); centerY.push_back(center.y);
+    prevX.push_back(prevCenter.x); prevY.push_back(prevCenter.y);
+    halfX.push_back(halfSize.x); halfY.push_back(halfSize.y);
+    id.push_back(boxId);
+}
+
+Physics::AABB Physics::BoxBatch::box(size_t i) const {
+    return { Vec2(centerX[i] - halfX[i], centerY[i] - halfY[i]), Vec2(centerX[i] + halfX[i], centerY[i] + halfY[i]) };
+}
+
+namespace {
+
+    // the entity side of a batch test, broadcast to every lane
+    struct Probe
+    {
+        float x, y, prevX, prevY, halfX, halfY;
+        bool hasPrevious;
+    };
+
+    using Kernel = size_t(*)(const Probe&, const Physics::BoxBatch&, std::vector<Physics::BatchHit>&);
+
+    // the same sums as getOverlap, in the same order, so every kernel gives
+    // bit identical overlaps
+    void testScalar(const Probe& a, const Physics::BoxBatch& b, size_t begin, std::vector<Physics::BatchHit>& hits) {
+        for (size_t i = begin; i < b.size(); ++i) {
+            float halfX = a.halfX + b.halfX[i];
+            float halfY = a.halfY + b.halfY[i];
+            Vec2 overlap(halfX - std::abs(a.x - b.centerX[i]), halfY - std::abs(a.y - b.centerY[i]));
+            if (overlap.x > 0 && overlap.y > 0) {
+                Vec2 prevOverlap(halfX - std::abs(a.prevX - b.prevX[i]), halfY - std::abs(a.prevY - b.prevY[i]));
+                hits.push_back({ static_cast<uint32_t>(i), overlap, a.hasPrevious ? prevOverlap : Vec2(0.f, 0.f) });
+            }
+        }
+    }
+
+#ifdef PHYSICS_X86
+    // writes the lanes set in mask out as hits
+    void emitLanes(int mask, size_t base, const float* ox, const float* oy, const float* px, const float* py,
+                   bool hasPrevious, std::vector<Physics::BatchHit>& hits) {
+        for (int lane = 0; mask; ++lane, mask >>= 1) {
+            if (mask & 1)
+                hits.push_back({ static_cast<uint32_t>(base + lane), Vec2(ox[lane], oy[lane]),
+                                 hasPrevious ? Vec2(px[lane], py[lane]) : Vec2(0.f, 0.f) });
+        }
+    }
+
+    PHYSICS_TARGET("sse2")
+    size_t kernelSse2(const Probe& a, const Physics::BoxBatch& b, std::vector<Physics::BatchHit>& hits) {
+        const __m128 sign = _mm_set1_ps(-0.f), zero = _mm_setzero_ps();
+        const __m128 ax = _mm_set1_ps(a.x), ay = _mm_set1_ps(a.y);
+        const __m128 apx = _mm_set1_ps(a.prevX), apy = _mm_set1_ps(a.prevY);
+        const __m128 ahx = _mm_set1_ps(a.halfX), ahy = _mm_set1_ps(a.halfY);
+        alignas(16) float ox[4], oy[4], px[4], py[4];
+
+        size_t i = 0;
+        for (; i + 4 <= b.size(); i += 4) {
+            __m128 hx = _mm_add_ps(ahx, _mm_loadu_ps(&b.halfX[i]));
+            __m128 hy = _mm_add_ps(ahy, _mm_loadu_ps(&b.halfY[i]));
+            __m128 vx = _mm_sub_ps(hx, _mm_andnot_ps(sign, _mm_sub_ps(ax, _mm_loadu_ps(&b.centerX[i]))));
+            __m128 vy = _mm_sub_ps(hy, _mm_andnot_ps(sign, _mm_sub_ps(ay, _mm_loadu_ps(&b.centerY[i]))));
+            int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(vx, zero), _mm_cmpgt_ps(vy, zero)));
+            if (!mask)
+                continue;
+
+            _mm_store_ps(ox, vx);
+            _mm_store_ps(oy, vy);
+            _mm_store_ps(px, _mm_sub_ps(hx, _mm_andnot_ps(sign, _mm_sub_ps(apx, _mm_loadu_ps(&b.prevX[i])))));
+            _mm_store_ps(py, _mm_sub_ps(hy, _mm_andnot_ps(sign, _mm_sub_ps(apy, _mm_loadu_ps(&b.prevY[i])))));
+            emitLanes(mask, i, ox, oy, px, py, a.hasPrevious, hits);
+        }
+        return i;
+    }
+
+    PHYSICS_TARGET("avx2")
+    size_t kernelAvx2(const Probe& a, const Physics::BoxBatch& b, std::vector<Physics::BatchHit>& hits) {
+        const __m256 sign = _mm256_set1_ps(-0.f), zero = _mm256_setzero_ps();
+        const __m256 ax = _mm256_set1_ps(a.x), ay = _mm256_set1_ps(a.y);
+        const __m256 apx = _mm256_set1_ps(a.prevX), apy = _mm256_set1_ps(a.prevY);
+        const __m256 ahx = _mm256_set1_ps(a.halfX), ahy = _mm256_set1_ps(a.halfY);
+        alignas(32) float ox[8], oy[8], px[8], py[8];
+
+        size_t i = 0;
+        for (; i + 8 <= b.size(); i += 8) {
+            __m256 hx = _mm256_add_ps(ahx, _mm256_loadu_ps(&b.halfX[i]));
+            __m256 hy = _mm256_add_ps(ahy, _mm256_loadu_ps(&b.halfY[i]));
+            __m256 vx = _mm256_sub_ps(hx, _mm256_andnot_ps(sign, _mm256_sub_ps(ax, _mm256_loadu_ps(&b.centerX[i]))));
+            __m256 vy = _mm256_sub_ps(hy, _mm256_andnot_ps(sign, _mm256_sub_ps(ay, _mm256_loadu_ps(&b.centerY[i]))));
+            int mask = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(vx, zero, _CMP_GT_OQ), _mm256_cmp_ps(vy, zero, _CMP_GT_OQ)));
+            if (!mask)
+                continue;
+
+            _mm256_store_ps(ox, vx);
+            _mm256_store_ps(oy, vy);
+            _mm256_store_ps(px, _mm256_sub_ps(hx, _mm256_andnot_ps(sign, _mm256_sub_ps(apx, _mm256_loadu_ps(&b.prevX[i])))));
+            _mm256_store_ps(py, _mm256_sub_ps(hy, _mm256_andnot_ps(sign, _mm256_sub_ps(apy, _mm256_loadu_ps(&b.prevY[i])))));
+            emitLanes(mask, i, ox, oy, px, py, a.hasPrevious, hits);
+        }
+        return i;
+    }
+
+    bool cpuHasAvx2() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5));
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#else
+    size_t kernelScalar(const Probe& a, const Physics::BoxBatch& b, std::vector<Physics::BatchHit>& hits) {
+        testScalar(a, b, 0, hits);
+        return b.size();
+    }
+#endif
+
+    struct KernelChoice
+    {
+        Kernel		kernel;
+        const char*	name;
+    };
+
+    KernelChoice pickKernel() {
+#ifdef PHYSICS_X86
+        if (cpuHasAvx2())
+            return { kernelAvx2, "avx2" };
+        return { kernelSse2, "sse2" };
+#else
+        return { kernelScalar, "scalar" };
+#endif
+    }
+
+    const KernelChoice& kernel() {
+        static const KernelChoice choice = pickKernel();
+        return choice;
+    }
+}
+
+void Physics::overlapBatch(const Entity& a, const BoxBatch& candidates, std::vector<BatchHit>& hits) {
+    hits.clear();
+    if (!a.hasComponents<CTransform, CBoundingBox>())
+        return;
+
+    auto& tx = a.getComponent<CTransform>();
+    auto& bb = a.getComponent<CBoundingBox>();
+    Probe probe{ tx.pos.x, tx.pos.y, tx.prevPos.x, tx.prevPos.y, bb.halfSize.x, bb.halfSize.y, bb.has };
+
+    // whole vectors first, the leftover boxes one at a time
+    size_t done = kernel().kernel(probe, candidates, hits);
+    testScalar(probe, candidates, done, hits);
+}
+
+const char* Physics::overlapKernel() {
+    return kernel().name;
+}
+
+Physics::SpatialHash::SpatialHash(float cellSize)
+    : m_cellSize(cellSize)
+{}
+
+int Physics::SpatialHash::cellOf(float v) const {
+    return static_cast<int>(std::floor(v / m_cellSize));
+}
+
+uint64_t Physics::SpatialHash::key(int cx, int cy) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+}
+
+void Physics::SpatialHash::clear() {
+    for (auto& [cell, entities] : m_cells)
+        entities.clear();
+    m_count = 0;
+}
+
+void Physics::SpatialHash::insert(Entity* e) {
+    insert(e, getAABB(*e));
+}
+
+void Physics::SpatialHash::insert(Entity* e, const AABB& box) {
+    for (int cx = cellOf(box.min.x); cx <= cellOf(box.max.x); ++cx)
+        for (int cy = cellOf(box.min.y); cy <= cellOf(box.max.y); ++cy)
+            m_cells[key(cx, cy)].push_back(e);
+    ++m_count;
+}
+
+void Physics::SpatialHash::remove(Entity* e, const AABB& box) {
+    for (int cx = cellOf(box.min.x); cx <= cellOf(box.max.x); ++cx) {
+        for (int cy = cellOf(box.min.y); cy <= cellOf(box.max.y); ++cy) {
+            auto it = m_cells.find(key(cx, cy));
+            if (it == m_cells.end())
+                continue;
+            auto& entities = it->second;
+            auto found = std::find(entities.begin(), entities.end(), e);
+            if (found != entities.end()) {
+                *found = entities.back();
+                entities.pop_back();
+            }
+        }
+    }
+    --m_count;
+}
+
+void Physics::SpatialHash::move(Entity* e, const AABB& from, const AABB& to) {
+    // nothing to do while the box stays in the same cells
+    if (cellOf(from.min.x) == cellOf(to.min.x) && cellOf(from.max.x) == cellOf(to.max.x) &&
+        cellOf(from.min.y) == cellOf(to.min.y) && cellOf(from.max.y) == cellOf(to.max.y))
+        return;
+    remove(e, from);
+    insert(e, to);
+}
+
+void Physics::SpatialHash::query(const AABB& box, std::vector<Entity*>& out) const {
+    out.clear();
+    for (int cx = cellOf(box.min.x); cx <= cellOf(box.max.x); ++cx) {
+        for (int cy = cellOf(box.min.y); cy <= cellOf(box.max.y); ++cy) {
+            auto it = m_cells.find(key(cx, cy));
+            if (it != m_cells.end())
+                out.insert(out.end(), it->second.begin(), it->second.end());
+        }
+    }
+
+    // an entity spanning several cells shows up once per cell
+    std::sort(out.begin(), out.end(), [](auto a, auto b) { return a->getId() < b->getId(); });
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool Physics::SpatialHash::raycast(const Vec2& from, const Vec2& to, RayHit& hit) const {
+    // ground pieces are few and large, so the cells under the segment's box
+    // are as good as walking them one by one
+    thread_local std::vector<Entity*> candidates;
+    query({ Vec2(std::min(from.x, to.x), std::min(from.y, to.y)), Vec2(std::max(from.x, to.x), std::max(from.y, to.y)) }, candidates);
+
+    Vec2 delta(to.x - from.x, to.y - from.y);
+    Entity* nearest = nullptr;
+    for (auto e : candidates) {
+        if (segmentHit(from, delta, getAABB(*e), hit.t, hit.normal))
+            nearest = e;
+    }
+
+    if (!nearest)
+        return false;
+    hit.point = Vec2(from.x + delta.x * hit.t, from.y + delta.y * hit.t);
+    hit.entity = nearest;
+    return true;
+}
+
+
+Physics::TileGrid::TileGrid(const Vec2& cellSize)
+    : m_cellSize(cellSize)
+{}
+
+int Physics::TileGrid::cellX(float x) const {
+    return static_cast<int>(std::floor((x - m_anchor.x) / m_cellSize.x)) - m_originX;
+}
+
+int Physics::TileGrid::cellY(float y) const {
+    return static_cast<int>(std::floor((y - m_anchor.y) / m_cellSize.y)) - m_originY;
+}
+
+int Physics::TileGrid::lastCellX(float x) const {
+    return static_cast<int>(std::ceil((x - m_anchor.x) / m_cellSize.x)) - 1 - m_originX;
+}
+
+int Physics::TileGrid::lastCellY(float y) const {
+    return static_cast<int>(std::ceil((y - m_anchor.y) / m_cellSize.y)) - 1 - m_originY;
+}
+
+int Physics::TileGrid::cellIndex(int cx, int cy) const {
+    if (cx < 0 || cy < 0 || cx >= m_width || cy >= m_height)
+        return -1;
+    return cy * m_width + cx;
+}
+
+void Physics::TileGrid::clear() {
+    m_anchor = Vec2(0.f, 0.f);
+    m_originX = m_originY = m_width = m_height = 0;
+    m_cellStart.clear();
+    m_cellBoxes.clear();
+    m_boxes.clear();
+}
+
+void Physics::TileGrid::build(const std::vector<Entity*>& tiles) {
+    clear();
+    if (tiles.empty())
+        return;
+
+    std::vector<AABB> boxes;
+    boxes.reserve(tiles.size());
+    for (auto t : tiles)
+        boxes.push_back(getAABB(*t));
+
+    m_anchor = boxes.front().min;
+    int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+    for (auto& box : boxes) {
+        minX = std::min(minX, cellX(box.min.x));
+        minY = std::min(minY, cellY(box.min.y));
+        maxX = std::max(maxX, lastCellX(box.max.x));
+        maxY = std::max(maxY, lastCellY(box.max.y));
+    }
+    m_originX = minX;
+    m_originY = minY;
+    m_width = maxX - minX + 1;
+    m_height = maxY - minY + 1;
+
+    merge(boxes);
+    index();
+}
+
+void Physics::TileGrid::merge(const std::vector<AABB>& tiles) {
+    const float epsilon = 0.01f;
+    auto onCell = [&](const AABB& box) {
+        Vec2 corner((cellX(box.min.x + epsilon) + m_originX) * m_cellSize.x + m_anchor.x,
+                    (cellY(box.min.y + epsilon) + m_originY) * m_cellSize.y + m_anchor.y);
+        return std::abs(box.min.x - corner.x) < epsilon && std::abs(box.min.y - corner.y) < epsilon
+            && std::abs(box.max.x - box.min.x - m_cellSize.x) < epsilon
+            && std::abs(box.max.y - box.min.y - m_cellSize.y) < epsilon;
+    };
+
+    // cells filled by exactly one tile, stacked duplicates count once
+    std::vector<uint8_t> solid(static_cast<size_t>(m_width) * m_height, 0);
+    for (auto& box : tiles) {
+        if (onCell(box))
+            solid[cellY(box.min.y + epsilon) * m_width + cellX(box.min.x + epsilon)] = 1;
+        else
+            m_boxes.push_back(box);
+    }
+
+    // widest run first, then grow it down while every cell under it is free
+    for (int cy = 0; cy < m_height; ++cy) {
+        for (int cx = 0; cx < m_width; ++cx) {
+            if (!solid[cy * m_width + cx])
+                continue;
+
+            int w = 1;
+            while (cx + w < m_width && solid[cy * m_width + cx + w])
+                ++w;
+
+            int h = 1;
+            while (cy + h < m_height && std::all_of(solid.begin() + (cy + h) * m_width + cx,
+                                                    solid.begin() + (cy + h) * m_width + cx + w,
+                                                    [](uint8_t s) { return s; }))
+                ++h;
+
+            for (int y = cy; y < cy + h; ++y)
+                std::fill_n(solid.begin() + y * m_width + cx, w, uint8_t(0));
+
+            Vec2 min((cx + m_originX) * m_cellSize.x + m_anchor.x, (cy + m_originY) * m_cellSize.y + m_anchor.y);
+            m_boxes.push_back({ min, Vec2(min.x + w * m_cellSize.x, min.y + h * m_cellSize.y) });
+        }
+    }
+}
+
+void Physics::TileGrid::index() {
+    auto forEachCell = [this](const AABB& box, auto&& fn) {
+        for (int cy = cellY(box.min.y); cy <= lastCellY(box.max.y); ++cy)
+            for (int cx = cellX(box.min.x); cx <= lastCellX(box.max.x); ++cx)
+                fn(cy * m_width + cx);
+    };
+
+    // count per cell, prefix sum, then fill
+    m_cellStart.assign(static_cast<size_t>(m_width) * m_height + 1, 0);
+    for (auto& box : m_boxes)
+        forEachCell(box, [this](int cell) { ++m_cellStart[cell + 1]; });
+    for (size_t i = 1; i < m_cellStart.size(); ++i)
+        m_cellStart[i] += m_cellStart[i - 1];
+
+    m_cellBoxes.resize(m_cellStart.back());
+    std::vector<uint32_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (uint32_t i = 0; i < m_boxes.size(); ++i)
+        forEachCell(m_boxes[i], [&](int cell) { m_cellBoxes[fill[cell]++] = i; });
+}
+
+bool Physics::TileGrid::occupied(const Vec2& pos) const {
+    int cell = cellIndex(cellX(pos.x), cellY(pos.y));
+    return cell >= 0 && m_cellStart[cell + 1] > m_cellStart[cell];
+}
+
+bool Physics::TileGrid::raycast(const Vec2& from, const Vec2& to, RayHit& hit) const {
+    if (m_boxes.empty())
+        return false;
+
+    // start where the segment enters the grid
+    Vec2 delta(to.x - from.x, to.y - from.y);
+    Vec2 gridMin(m_originX * m_cellSize.x + m_anchor.x, m_originY * m_cellSize.y + m_anchor.y);
+    AABB bounds{ gridMin, Vec2(gridMin.x + m_width * m_cellSize.x, gridMin.y + m_height * m_cellSize.y) };
+    float tStart = 0.f;
+    if (!bounds.overlaps({ from, from })) {
+        Vec2 normal;
+        tStart = hit.t;
+        if (!segmentHit(from, delta, bounds, tStart, normal))
+            return false;
+    }
+
+    int cx = std::clamp(cellX(from.x + delta.x * tStart), 0, m_width - 1);
+    int cy = std::clamp(cellY(from.y + delta.y * tStart), 0, m_height - 1);
+
+    // Amanatides and Woo: t of the next vertical and horizontal cell edge,
+    // and how much t one cell takes on each axis
+    const float never = std::numeric_limits<float>::infinity();
+    int stepX = delta.x > 0.f ? 1 : -1, stepY = delta.y > 0.f ? 1 : -1;
+    float nextX = never, nextY = never, cellTX = never, cellTY = never;
+    if (delta.x != 0.f) {
+        float edge = (cx + m_originX + (stepX > 0 ? 1 : 0)) * m_cellSize.x + m_anchor.x;
+        nextX = (edge - from.x) / delta.x;
+        cellTX = m_cellSize.x / std::abs(delta.x);
+    }
+    if (delta.y != 0.f) {
+        float edge = (cy + m_originY + (stepY > 0 ? 1 : 0)) * m_cellSize.y + m_anchor.y;
+        nextY = (edge - from.y) / delta.y;
+        cellTY = m_cellSize.y / std::abs(delta.y);
+    }
+
+    // a hit before the segment leaves a cell beats anything in later cells
+    bool found = false;
+    while (true) {
+        int cell = cy * m_width + cx;
+        for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i)
+            found |= segmentHit(from, delta, m_boxes[m_cellBoxes[i]], hit.t, hit.normal);
+
+        if (std::min(nextX, nextY) >= hit.t)
+            break;
+        if (nextX < nextY) {
+            cx += stepX;
+            nextX += cellTX;
+        }
+        else {
+            cy += stepY;
+            nextY += cellTY;
+        }
+        if (cellIndex(cx, cy) < 0)
+            break;
+    }
+
+    if (found) {
+        hit.point = Vec2(from.x + delta.x * hit.t, from.y + delta.y * hit.t);
+        hit.entity = nullptr;
+    }
+    return found;
+}
+
+void Physics::TileGrid::query(const AABB& box, BoxBatch& out) const {
+    out.clear();
+    if (m_boxes.empty())
+        return;
+
+    int x0 = std::max(cellX(box.min.x), 0), x1 = std::min(cellX(box.max.x), m_width - 1);
+    int y0 = std::max(cellY(box.min.y), 0), y1 = std::min(cellY(box.max.y), m_height - 1);
+
+    thread_local std::vector<uint32_t> found;
+    found.clear();
+    for (int cy = y0; cy <= y1; ++cy) {
+        for (int cx = x0; cx <= x1; ++cx) {
+            int cell = cy * m_width + cx;
+            found.insert(found.end(), m_cellBoxes.begin() + m_cellStart[cell], m_cellBoxes.begin() + m_cellStart[cell + 1]);
+        }
+    }
+
+    // a rectangle spanning several cells shows up once per cell
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+
+    for (auto i : found)
+        out.push(m_boxes[i], i);
+}
+
+
+Physics::CollisionMatrix::CollisionMatrix()
+    : m_kinds(MaxLayers * MaxLayers, -1)
+{}
+
+void Physics::CollisionMatrix::setLayer(EntityTag tag, uint32_t layer) {
+    if (tag >= m_layerOf.size())
+        m_layerOf.resize(tag + 1, NoLayer);
+    if (m_layerOf[tag] == NoLayer)
+        m_tags.push_back(tag);
+    m_layerOf[tag] = layer;
+}
+
+uint32_t Physics::CollisionMatrix::layerOf(EntityTag tag) const {
+    return tag < m_layerOf.size() ? m_layerOf[tag] : NoLayer;
+}
+
+void Physics::CollisionMatrix::onContact(uint32_t a, uint32_t b, Handler handler) {
+    m_masks[a] |= 1u << b;
+    m_masks[b] |= 1u << a;
+    m_kinds[a * MaxLayers + b] = static_cast<int>(m_handlers.size());
+    m_handlers.push_back(std::move(handler));
+}
+
+bool Physics::CollisionMatrix::collides(uint32_t a, uint32_t b) const {
+    return (m_masks[a] >> b) & 1u;
+}
+
+int Physics::CollisionMatrix::kindOf(uint32_t a, uint32_t b) const {
+    return m_kinds[a * MaxLayers + b];
+}
+
+void Physics::SweepAndPrune::clear() {
+    m_entries.clear();
+    m_tracked.clear();
+    m_pairs.clear();
+}
+
+bool Physics::SweepAndPrune::isTracked(const Entity& e) const {
+    return e.getId() < m_tracked.size() && m_tracked[e.getId()] == e.getHandle().generation + 1;
+}
+
+void Physics::SweepAndPrune::setTracked(const Entity& e, bool tracked) {
+    if (e.getId() >= m_tracked.size())
+        m_tracked.resize(e.getId() + 1, 0);
+    m_tracked[e.getId()] = tracked ? e.getHandle().generation + 1 : 0;
+}
+
+void Physics::SweepAndPrune::update(EntityManager& manager, const CollisionMatrix& layers) {
+    auto boxOf = [](const Entity& e) {
+        return e.getComponent<CBoundingBox>().swept ? getSweptAABB(e) : getAABB(e);
+    };
+
+    // boxes where everything is now, dropping whatever was destroyed
+    size_t kept = 0;
+    for (auto& entry : m_entries) {
+        auto e = manager.get(entry.handle);
+        if (!e || !e->isActive() || !e->hasComponents<CTransform, CBoundingBox>()) {
+            m_tracked[entry.handle.index] = 0;
+            continue;
+        }
+        entry.box = boxOf(*e);
+        m_entries[kept++] = entry;
+    }
+    m_entries.resize(kept);
+
+    // still nearly in order from last frame, so insertion sort is close to
+    // a single pass
+    for (size_t i = 1; i < m_entries.size(); ++i) {
+        Entry entry = m_entries[i];
+        size_t j = i;
+        for (; j > 0 && entry.box.min.x < m_entries[j - 1].box.min.x; --j)
+            m_entries[j] = m_entries[j - 1];
+        m_entries[j] = entry;
+    }
+
+    // newcomers can land anywhere, they are sorted on their own and merged in
+    auto byLeftEdge = [](const Entry& x, const Entry& y) { return x.box.min.x < y.box.min.x; };
+    for (auto tag : layers.tags()) {
+        uint32_t layer = layers.layerOf(tag);
+        for (auto e : manager.getEntities(tag)) {
+            if (e->isActive() && !isTracked(*e) && e->hasComponents<CTransform, CBoundingBox>()) {
+                setTracked(*e, true);
+                m_entries.push_back({ e, e->getHandle(), layer, boxOf(*e) });
+            }
+        }
+    }
+
+    if (m_entries.size() > kept) {
+        std::sort(m_entries.begin() + kept, m_entries.end(), byLeftEdge);
+        std::inplace_merge(m_entries.begin(), m_entries.begin() + kept, m_entries.end(), byLeftEdge);
+    }
+
+    m_pairs.clear();
+    auto report = [this](int kind, Entity* a, Entity* b) {
+
+        // the sweep is inclusive, the final say is the same test every
+        // narrowphase uses, or the time of impact when either side is fast
+        if (a->getComponent<CBoundingBox>().swept || b->getComponent<CBoundingBox>().swept) {
+            float time = timeOfImpact(*a, *b);
+            if (time >= 0.f)
+                m_pairs.push_back({ static_cast<uint32_t>(kind), a, b, time });
+            return;
+        }
+
+        auto overlap = getOverlap(*a, *b);
+        if (overlap.x > 0 && overlap.y > 0)
+            m_pairs.push_back({ static_cast<uint32_t>(kind), a, b, 1.f });
+    };
+
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        auto& first = m_entries[i];
+        for (size_t j = i + 1; j < m_entries.size() && m_entries[j].box.min.x <= first.box.max.x; ++j) {
+            auto& second = m_entries[j];
+            if (!layers.collides(first.layer, second.layer))
+                continue;
+            if (second.box.min.y > first.box.max.y || first.box.min.y > second.box.max.y)
+                continue;
+
+            // a is on the layer onContact() named first, the lower id when
+            // both are on the same layer
+            auto* x = &first;
+            auto* y = &second;
+            if (y->entity->getId() < x->entity->getId())
+                std::swap(x, y);
+            if (int kind = layers.kindOf(x->layer, y->layer); kind >= 0)
+                report(kind, x->entity, y->entity);
+            if (x->layer != y->layer)
+                if (int kind = layers.kindOf(y->layer, x->layer); kind >= 0)
+                    report(kind, y->entity, x->entity);
+        }
+    }
+
+    std::sort(m_pairs.begin(), m_pairs.end(), [](const Pair& x, const Pair& y) {
+        if (x.kind != y.kind)
+            return x.kind < y.kind;
+        if (x.a->getId() != y.a->getId())
+            return x.a->getId() < y.a->getId();
+        if (x.time != y.time)
+            return x.time < y.time;
+        return x.b->getId() < y.b->getId();
+    });
+}
+
+bool Physics::SweepAndPrune::raycast(EntityManager& manager, const Vec2& from, const Vec2& to, uint32_t layerMask, RayHit& hit) const {
+    Vec2 delta(to.x - from.x, to.y - from.y);
+    float left = std::min(from.x, to.x), right = std::max(from.x, to.x);
+
+    // entries are sorted by left edge, so the ones past the segment's right
+    // end can all be skipped at once
+    const Entry* nearest = nullptr;
+    for (auto& entry : m_entries) {
+        if (entry.box.min.x > right)
+            break;
+        if (entry.box.max.x < left || !(layerMask & (1u << entry.layer)))
+            continue;
+        auto e = manager.get(entry.handle);
+        if (e && e->isActive() && segmentHit(from, delta, entry.box, hit.t, hit.normal))
+            nearest = &entry;
+    }
+
+    if (!nearest)
+        return false;
+    hit.point = Vec2(from.x + delta.x * hit.t, from.y + delta.y * hit.t);
+    hit.entity = nearest->entity;
+    return true;
+}
+
+void Physics::ContactCache::clear() {
+    m_contacts.clear();
+    m_touched.clear();
+    m_events.clear();
+}
+
+std::pair<size_t, size_t> Physics::ContactCache::range(EntityHandle entity) const {
+    auto first = std::lower_bound(m_contacts.begin(), m_contacts.end(), entity,
+        [](const Contact& c, EntityHandle h) { return c.entity < h; });
+    auto last = std::upper_bound(first, m_contacts.end(), entity,
+        [](EntityHandle h, const Contact& c) { return h < c.entity; });
+    return { static_cast<size_t>(first - m_contacts.begin()), static_cast<size_t>(last - m_contacts.begin()) };
+}
+
+void Physics::ContactCache::touch(const Entity& e, uint32_t other, const AABB& box, const Vec2& normal) {
+    m_touched.push_back({ e.getHandle(), other, box, normal });
+}
+
+void Physics::ContactCache::settle(const Entity& e) {
+    EntityHandle handle = e.getHandle();
+    size_t first = m_touched.size();
+    while (first > 0 && m_touched[first - 1].entity == handle)
+        --first;
+    size_t resolved = m_touched.size();
+
+    // last step's contacts that were not resolved this time but that e still
+    // rests against: the gap along the normal is within Slop and the boxes
+    // overlap across it
+    AABB a = getAABB(e);
+    auto [begin, end] = range(handle);
+    for (size_t i = begin; i < end; ++i) {
+        const auto& c = m_contacts[i];
+        bool again = std::any_of(m_touched.begin() + first, m_touched.begin() + resolved,
+            [&c](const Contact& t) { return t.other == c.other; });
+        if (again)
+            continue;
+
+        float gap, across;
+        if (c.normal.y != 0.f) {
+            gap = c.normal.y < 0.f ? c.box.min.y - a.max.y : a.min.y - c.box.max.y;
+            across = std::min(a.max.x, c.box.max.x) - std::max(a.min.x, c.box.min.x);
+        }
+        else {
+            gap = c.normal.x < 0.f ? c.box.min.x - a.max.x : a.min.x - c.box.max.x;
+            across = std::min(a.max.y, c.box.max.y) - std::max(a.min.y, c.box.min.y);
+        }
+        if (std::abs(gap) <= Slop && across > 0.f)
+            m_touched.push_back(c);
+    }
+
+    auto& tx = e.getComponent<CTransform>();
+    for (size_t i = first; i < m_touched.size(); ++i)
+        m_touched[i].at = tx.pos;
+}
+
+void Physics::ContactCache::end() {
+    auto byKey = [](const Contact& x, const Contact& y) {
+        return x.entity != y.entity ? x.entity < y.entity : x.other < y.other;
+    };
+    std::sort(m_touched.begin(), m_touched.end(), byKey);
+
+    // both sides are sorted, so one merge tells new, kept and lost apart
+    m_events.clear();
+    size_t i = 0, j = 0;
+    while (i < m_contacts.size() || j < m_touched.size()) {
+        if (j == m_touched.size() || (i < m_contacts.size() && byKey(m_contacts[i], m_touched[j]))) {
+            m_events.push_back(m_contacts[i++]);
+            m_events.back().phase = Phase::Exit;
+        }
+        else if (i == m_contacts.size() || byKey(m_touched[j], m_contacts[i])) {
+            m_touched[j].phase = Phase::Enter;
+            m_events.push_back(m_touched[j++]);
+        }
+        else {
+            m_touched[j++].phase = Phase::Stay;
+            ++i;
+        }
+    }
+
+    m_contacts.swap(m_touched);
+    m_touched.clear();
+}
+
+const Physics::ContactCache::Contact* Physics::ContactCache::support(const Entity& e) const {
+    const Contact* highest = nullptr;
+    auto [begin, end] = range(e.getHandle());
+    for (size_t i = begin; i < end; ++i) {
+        if (m_contacts[i].normal.y < 0.f && (!highest || m_contacts[i].box.min.y < highest->box.min.y))
+            highest = &m_contacts[i];
+    }
+    return highest;
+}
+
+bool Physics::ContactCache::supported(EntityHandle entity) const {
+    auto [begin, end] = range(entity);
+    return std::any_of(m_contacts.begin() + begin, m_contacts.begin() + end, [](const Contact& c) { return c.normal.y < 0.f; });
+}
+
+bool Physics::raycast(const TileGrid& terrain, const SpatialHash& ground, const SweepAndPrune& bodies, EntityManager& manager,
+    const Vec2& from, const Vec2& to, uint32_t layerMask, RayHit& hit) {
+    bool blocked = terrain.raycast(from, to, hit);
+    blocked |= ground.raycast(from, to, hit);
+    return bodies.raycast(manager, from, to, layerMask, hit) || blocked;
+}
@@ -2,10 +2,311 @@
 
 #include "Common.h"
 #include "Entity.h"
+#include <functional>
+#include <unordered_map>
+
+// forward declarations
+class EntityManager;
+class EntityCommands;
 
 namespace Physics
 {
-	Vec2 getOverlap(std::shared_ptr<Entity> a, std::shared_ptr<Entity> b);
-	Vec2 getPreviousOverlap(std::shared_ptr<Entity> a, std::shared_ptr<Entity> b);
-};
+	struct AABB
+	{
+		Vec2 min;
+		Vec2 max;
+
+		bool overlaps(const AABB& other) const;
+		AABB expanded(const Vec2& margin) const;
+		Vec2 center() const;
+		Vec2 halfSize() const;
+	};
+
+	// The first thing a segment touches, t is how far along it the hit is.
+	// Queries only report hits closer than the t they are given, so one hit
+	// can be passed through several of them.
+	struct RayHit
+	{
+		float	t{ 1.f };
+		Vec2	point;
+		Vec2	normal;				// face that was hit, zero when the segment starts inside
+		Entity*	entity{ nullptr };	// null for tiles
+	};
+
+	// slab test of the segment from `from` to from + delta, t and normal are
+	// only changed when box is entered before t
+	bool segmentHit(const Vec2& from, const Vec2& delta, const AABB& box, float& t, Vec2& normal);
+
+	Vec2 getOverlap(const Entity& a, const Entity& b);
+	Vec2 getPreviousOverlap(const Entity& a, const Entity& b);
+	Vec2 getOverlap(const Entity& a, const AABB& b);			// b is static terrain
+	Vec2 getPreviousOverlap(const Entity& a, const AABB& b);
+
+
+	// Candidate boxes for one narrowphase pass, one array per coordinate so
+	// the overlap test can run over several boxes per instruction.
+	struct BoxBatch
+	{
+		std::vector<float>	centerX, centerY;
+		std::vector<float>	prevX, prevY;		// centre last frame, same as now for terrain
+		std::vector<float>	halfX, halfY;
+		std::vector<uint32_t>	id;				// whatever the filler uses to name a box
+
+		void	clear();
+		void	push(const AABB& box, uint32_t boxId = 0);
+		void	push(const Vec2& center, const Vec2& prevCenter, const Vec2& halfSize, uint32_t boxId = 0);
+		size_t	size() const { return centerX.size(); }
+		AABB	box(size_t i) const;
+	};
+
+	struct BatchHit
+	{
+		uint32_t	index;			// into the batch
+		Vec2		overlap;
+		Vec2		prevOverlap;
+	};
+
+	// every box in candidates overlapping a right now, in batch order, with
+	// the overlaps getOverlap and getPreviousOverlap would give
+	void overlapBatch(const Entity& a, const BoxBatch& candidates, std::vector<BatchHit>& hits);
+	const char* overlapKernel();	// instruction set picked for this CPU
+	AABB getAABB(const Entity& e);		// current transform and bounding box
+
+	// one step of a body: a dynamic body that has not moved for SleepFrames
+	// steps stops being integrated until it gets a velocity again. A supported
+	// body stands on something that takes its gravity, so only its horizontal
+	// speed counts. Returns true on the step it falls asleep, the caller then
+	// takes its CAwake away
+	constexpr int	SleepFrames{ 30 };
+	constexpr float	RestSpeed{ 0.01f };		// pixels per step that still count as resting
+	bool integrate(CBody& body, CTransform& transform, bool supported);
+	bool isAsleep(const Entity& e);
+	// a sleeping body that has been given a velocity or moved gets its
+	// CAwake back, whatever drives a body calls this after steering it
+	void wake(Entity& e, EntityCommands& commands);
+	AABB getSweptAABB(const Entity& e);	// covers the box at prevPos and at pos
+
+	// Earliest fraction of this step, 0 to 1, at which a and b touch while
+	// both move from prevPos to pos, or -1 when they never do. Boxes that
+	// already overlap at the start of the step meet at 0.
+	float timeOfImpact(const Entity& a, const Entity& b);
+	float timeOfImpact(const Entity& a, const AABB& b);		// b is static terrain
+
+
+	// Uniform grid broadphase, cells are hashed so the level can be any size.
+	// An entity is stored in every cell its box covers; query() hands back
+	// each candidate once, ordered by entity id so results do not depend on
+	// the hash layout.
+	class SpatialHash
+	{
+		float												m_cellSize;
+		std::unordered_map<uint64_t, std::vector<Entity*>>	m_cells;
+		size_t												m_count{ 0 };
+
+		int		cellOf(float v) const;
+		static uint64_t	key(int cx, int cy);
+
+	public:
+		explicit SpatialHash(float cellSize);
+
+		void	clear();		// keeps the cells' storage for the next rebuild
+		void	insert(Entity* e, const AABB& box);
+		void	insert(Entity* e);
+		void	remove(Entity* e, const AABB& box);
+		void	move(Entity* e, const AABB& from, const AABB& to);
+		size_t	size() const { return m_count; }
+
+		// entities whose cells overlap box, written to out
+		void	query(const AABB& box, std::vector<Entity*>& out) const;
+		// first entity whose box the segment enters, hit.entity is set to it
+		bool	raycast(const Vec2& from, const Vec2& to, RayHit& hit) const;
+	};
+
+
+	// Static terrain laid out on the level grid, built once when the level is
+	// loaded. Tiles that fill exactly one cell are merged greedily into
+	// maximal rectangles, anything else keeps its own box. Every cell keeps
+	// the rectangles covering it as a run of indices into one flat array, so
+	// a lookup is a bounds check and a couple of reads no matter how many
+	// tiles the level has. Only collision uses the rectangles, the tiles are
+	// still drawn one by one.
+	class TileGrid
+	{
+		Vec2					m_cellSize;
+		Vec2					m_anchor;			// a cell corner, tiles on the grid line up with it
+		int						m_originX{ 0 };		// cell of column 0 and row 0
+		int						m_originY{ 0 };
+		int						m_width{ 0 };
+		int						m_height{ 0 };
+		std::vector<uint32_t>	m_cellStart;		// m_width * m_height + 1 offsets into m_cellBoxes
+		std::vector<uint32_t>	m_cellBoxes;		// box indices, grouped by cell
+		std::vector<AABB>		m_boxes;
+
+		int		cellX(float x) const;
+		int		cellY(float y) const;
+		int		lastCellX(float x) const;			// a box ending on a cell edge stays out of the next cell
+		int		lastCellY(float y) const;
+		int		cellIndex(int cx, int cy) const;	// -1 outside the grid
+		void	merge(const std::vector<AABB>& tiles);
+		void	index();
+
+	public:
+		explicit TileGrid(const Vec2& cellSize);
+
+		void	clear();
+		void	build(const std::vector<Entity*>& tiles);
+		size_t	size() const { return m_boxes.size(); }
+		const std::vector<AABB>&	boxes() const { return m_boxes; }
+		bool	occupied(const Vec2& pos) const;
+
+		// rectangles in the cells box covers, each once and in build order,
+		// with their index in boxes() as id
+		void	query(const AABB& box, BoxBatch& out) const;
 
+		// first rectangle on the segment, walking only the cells it crosses
+		bool	raycast(const Vec2& from, const Vec2& to, RayHit& hit) const;
+	};
+
+
+	// Which entities collide with which, and what happens when they do.
+	// Tags are put on layers, layers are paired with onContact(), and every
+	// pair gets its handler. Adding a new kind of pickup is one setLayer()
+	// call, nothing in the detection pass changes.
+	class CollisionMatrix
+	{
+	public:
+		using Handler = std::function<void(Entity& a, Entity& b)>;
+		static constexpr uint32_t MaxLayers{ 32 };
+		static constexpr uint32_t NoLayer{ UINT32_MAX };
+
+	private:
+		std::vector<uint32_t>	m_layerOf;				// by tag
+		std::vector<EntityTag>	m_tags;					// every tag with a layer
+		uint32_t				m_masks[MaxLayers]{};	// bit b of m_masks[a] when a and b collide
+		std::vector<int>		m_kinds;				// a * MaxLayers + b, -1 when not paired
+		std::vector<Handler>	m_handlers;				// by kind
+
+	public:
+		CollisionMatrix();
+
+		void		setLayer(EntityTag tag, uint32_t layer);
+		uint32_t	layerOf(EntityTag tag) const;
+		const std::vector<EntityTag>&	tags() const { return m_tags; }
+
+		// contacts between layer a and layer b go to handler, a first; kinds
+		// are numbered in the order they are registered
+		void		onContact(uint32_t a, uint32_t b, Handler handler);
+		bool		collides(uint32_t a, uint32_t b) const;
+		int			kindOf(uint32_t a, uint32_t b) const;
+
+		// calls the handler of every pair in order, skipping pairs where an
+		// earlier handler destroyed either side
+		template <typename Pairs>
+		void dispatch(const Pairs& pairs) const
+		{
+			for (auto& pair : pairs)
+				if (pair.a->isActive() && pair.b->isActive())
+					m_handlers[pair.kind](*pair.a, *pair.b);
+		}
+	};
+
+
+	// Sort and sweep broadphase for everything that moves or gets picked up.
+	// Boxes are kept sorted by their left edge from one frame to the next, so
+	// after a frame of small moves an insertion sort puts them back in order
+	// in close to linear time, and the sweep only looks at boxes whose x
+	// ranges meet. Which pairs are wanted comes from a CollisionMatrix.
+	// Swept entities are entered with the box of their whole step and their
+	// pairs are found by time of impact, so they cannot pass through
+	// anything between two frames.
+	class SweepAndPrune
+	{
+	public:
+		struct Pair
+		{
+			uint32_t	kind;		// CollisionMatrix::kindOf the two layers
+			Entity*		a;			// on the first layer given to onContact()
+			Entity*		b;
+			float		time;		// time of impact for swept pairs, 1 otherwise
+		};
+
+	private:
+		struct Entry
+		{
+			Entity*			entity;
+			EntityHandle	handle;
+			uint32_t		layer;
+			AABB			box;
+		};
+
+		std::vector<Entry>		m_entries;			// sorted by box.min.x
+		std::vector<uint32_t>	m_tracked;			// per slot, generation + 1 of the entity in m_entries
+		std::vector<Pair>		m_pairs;
+
+		bool	isTracked(const Entity& e) const;
+		void	setTracked(const Entity& e, bool tracked);
+
+	public:
+		void	clear();	// forget every entity, for a new EntityManager
+
+		// refresh boxes, drop entities that are gone, pick up new ones and
+		// sweep; pairs come back grouped by kind, then by id of a, then
+		// earliest impact first
+		void	update(EntityManager& manager, const CollisionMatrix& layers);
+		const std::vector<Pair>&	pairs() const { return m_pairs; }
+		size_t	size() const { return m_entries.size(); }
+
+		// first entity on the segment whose layer bit is set in layerMask,
+		// against the boxes of the last update()
+		bool	raycast(EntityManager& manager, const Vec2& from, const Vec2& to, uint32_t layerMask, RayHit& hit) const;
+	};
+
+	// Contacts between moving entities and terrain that last from one step to
+	// the next. A step touch()es every contact its resolution produces and
+	// settle()s each entity when it is done with it; end() compares the step
+	// with the one before and reports contacts that began (Enter) or ended
+	// (Exit). A contact that was not resolved again but still touches, like a
+	// body resting on a platform, is carried over by settle() without any
+	// narrowphase work.
+	class ContactCache
+	{
+	public:
+		enum class Phase : uint8_t { Enter, Stay, Exit };
+
+		struct Contact
+		{
+			EntityHandle	entity;
+			uint32_t		other;		// the caller's key for the terrain piece
+			AABB			box;		// the terrain piece
+			Vec2			normal;		// the way the entity was pushed, (0, -1) when standing on box
+			Vec2			at{ 0.f, 0.f };	// entity position once the step was done with it, set by settle
+			Phase			phase{ Phase::Enter };
+		};
+
+		static constexpr float Slop{ 0.1f };	// gap that still counts as touching
+
+	private:
+		std::vector<Contact>	m_contacts;		// last step, sorted by entity then other
+		std::vector<Contact>	m_touched;		// this step, grouped by entity
+		std::vector<Contact>	m_events;		// Enter and Exit of the last end()
+
+		std::pair<size_t, size_t>	range(EntityHandle entity) const;	// of entity in m_contacts
+
+	public:
+		void	clear();
+
+		// the contacts of one entity have to be touched and settled together
+		void	touch(const Entity& e, uint32_t other, const AABB& box, const Vec2& normal);
+		void	settle(const Entity& e);
+		void	end();
+
+		// what e stood on last step, the highest piece if several
+		const Contact*	support(const Entity& e) const;
+		bool			supported(EntityHandle entity) const;	// after end()
+		const std::vector<Contact>&	events() const { return m_events; }
+	};
+
+	// nearest of the tiles, the ground pieces and the dynamic bodies on the segment
+	bool raycast(const TileGrid& terrain, const SpatialHash& ground, const SweepAndPrune& bodies, EntityManager& manager,
+		const Vec2& from, const Vec2& to, uint32_t layerMask, RayHit& hit);
+};
@@ -0,0 +1,18 @@
+#include "Prefab.h"
+
+bool PrefabRegistry::has(const std::string& name) const
+{
+	return m_prefabs.contains(name);
+}
+
+const Prefab& PrefabRegistry::get(const std::string& name) const
+{
+	auto it = m_prefabs.find(name);
+	if (it != m_prefabs.end()) {
+		return it->second;
+	}
+	else {
+		std::cerr << "Prefab not found: " << name << std::endl;
+		throw std::out_of_range("Prefab not found: " + name);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Common.h"
+#include "ComponentStore.h"
+#include <unordered_map>
+
+// A named set of components entities are stamped from. Built once from the
+// assets, then copied into the pools by EntityManager::instantiate, so a
+// spawn does no asset lookups and no Animation construction of its own.
+struct Prefab
+{
+	std::string						name;
+	EntityTag						tag{ 0 };
+	std::vector<ComponentVariant>	components;
+
+	template <typename T>
+	Prefab& add(T&& component)
+	{
+		components.emplace_back(std::forward<T>(component));
+		return *this;
+	}
+
+	template <typename T>
+	const T* get() const
+	{
+		for (auto& component : components)
+			if (auto c = std::get_if<T>(&component))
+				return c;
+		return nullptr;
+	}
+};
+
+
+class PrefabRegistry
+{
+	std::unordered_map<std::string, Prefab> m_prefabs;	// node based, prefabs never move
+
+public:
+	// replaces a prefab of the same name
+	template <typename... Cs>
+	Prefab& add(const std::string& name, EntityTag tag, Cs&&... components)
+	{
+		auto& prefab = m_prefabs[name];
+		prefab = Prefab{ name, tag, {} };
+		prefab.components.reserve(sizeof...(Cs));
+		(prefab.add(std::forward<Cs>(components)), ...);
+		return prefab;
+	}
+
+	bool			has(const std::string& name) const;
+	const Prefab&	get(const std::string& name) const;
+};
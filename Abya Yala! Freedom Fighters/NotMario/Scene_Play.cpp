@@ -8,6 +8,39 @@
 
 static void drawGradientText(sf::RenderWindow& window, sf::Text& text, const sf::Color& gradientTop, const sf::Color& gradientBottom, sf::Shader& shader);
 
+namespace Tag {
+    // interned once so the systems below index tag lists directly
+    const EntityTag Player          = EntityManager::tagId("player");
+    const EntityTag Tile            = EntityManager::tagId("tile");
+    const EntityTag Ground          = EntityManager::tagId("ground");
+    const EntityTag Dec             = EntityManager::tagId("dec");
+    const EntityTag Enemy           = EntityManager::tagId("enemy");
+    const EntityTag StrongerEnemy   = EntityManager::tagId("stronger_enemy");
+    const EntityTag Bullet          = EntityManager::tagId("bullet");
+    const EntityTag EnemyBullet     = EntityManager::tagId("enemy_bullet");
+    const EntityTag Coin            = EntityManager::tagId("coin");
+    const EntityTag Arrow           = EntityManager::tagId("arrow");
+    const EntityTag Bottle          = EntityManager::tagId("Bottle");
+    const EntityTag Fruit           = EntityManager::tagId("Fruit");
+    const EntityTag Book            = EntityManager::tagId("book");
+    const EntityTag Key             = EntityManager::tagId("key");
+    const EntityTag Door            = EntityManager::tagId("door");
+    const EntityTag Chest           = EntityManager::tagId("chest");
+}
+
+// everything that moves, the rest of a level stays where it was placed
+const EntityTag MovingTags[] = { Tag::Player, Tag::Enemy, Tag::StrongerEnemy, Tag::Bullet, Tag::EnemyBullet };
+
+namespace DrawLayer {
+    // back to front, sprites on one layer should not overlap across textures
+    enum : int { Terrain, Decorations, Props, Actors, Shots, Player };
+}
+
+namespace Layer {
+    // collision layers, see registerCollisionLayers for who meets whom
+    enum : uint32_t { Player, PlayerShot, Enemy, EnemyShot, Pickup, Interactive };
+}
+
 Scene_Play::Scene_Play(GameEngine* gameEngine, const std::string& levelPath)
     : Scene(gameEngine)
     , m_levelPath(levelPath) {
@@ -16,6 +49,7 @@ Scene_Play::Scene_Play(GameEngine* gameEngine, const std::string& levelPath)
 
 void Scene_Play::init(const std::string& levelPath) {
     registerActions();
+    registerCollisionLayers();
 
     m_gridText.setCharacterSize(12);
     m_gridText.setFont(m_game->assets().getFont("Arial"));
@@ -70,6 +104,116 @@ void Scene_Play::registerActions() {
     registerAction(sf::Keyboard::F, "INTERACT"); 
 }
 
+void Scene_Play::registerCollisionLayers() {
+    auto& layers = m_collisionLayers;
+    layers.setLayer(Tag::Player, Layer::Player);
+    layers.setLayer(Tag::Bullet, Layer::PlayerShot);
+    layers.setLayer(Tag::Enemy, Layer::Enemy);
+    layers.setLayer(Tag::StrongerEnemy, Layer::Enemy);
+    layers.setLayer(Tag::EnemyBullet, Layer::EnemyShot);
+    for (auto tag : { Tag::Coin, Tag::Book, Tag::Key, Tag::Bottle, Tag::Fruit })
+        layers.setLayer(tag, Layer::Pickup);
+    for (auto tag : { Tag::Door, Tag::Chest })
+        layers.setLayer(tag, Layer::Interactive);
+
+    // handled in this order every frame
+    layers.onContact(Layer::Player, Layer::Pickup, [this](Entity& p, Entity& e) { onPickup(p, e); });
+    layers.onContact(Layer::Player, Layer::Interactive, [this](Entity& p, Entity& e) { onInteractive(p, e); });
+    layers.onContact(Layer::Player, Layer::EnemyShot, [this](Entity& p, Entity& e) { onEnemyShot(p, e); });
+    layers.onContact(Layer::PlayerShot, Layer::Enemy, [this](Entity& b, Entity& e) { onPlayerShot(b, e); });
+    layers.onContact(Layer::Player, Layer::Enemy, [this](Entity& p, Entity& e) { onEnemyContact(p, e); });
+}
+
+void Scene_Play::registerPrefabs() {
+    auto& assets = m_game->assets();
+
+    // the player's arrows use the weapon named in the level file
+    auto& weapon = assets.getAnimation(m_playerConfig.WEAPON);
+    Vec2 arrowSize = weapon.getSize();
+    for (bool isFacingLeft : { false, true }) {
+        CAnimation animation(weapon, true);
+        animation.setFlipped(isFacingLeft);
+
+        CTransform transform;
+        transform.vel.x = 15 * (isFacingLeft ? -1 : 1); // Increase velocity to 15 (or any other value)
+        transform.scale.x = isFacingLeft ? -1 : 1;
+
+        CBoundingBox boundingBox(Vec2(arrowSize.x * 0.5f, arrowSize.y * 0.5f)); // smaller bounding box for the arrow
+        boundingBox.swept = true; // fast enough to skip past a narrow enemy in one step
+
+        m_prefabs.add(isFacingLeft ? "PlayerArrowLeft" : "PlayerArrowRight", Tag::Bullet,
+            animation,
+            transform,
+            boundingBox,
+            CLifespan(15), // Adjust the lifespan value as needed
+            CBody(CBody::Kinematic),
+            CAwake());
+    }
+
+    for (bool isFacingLeft : { false, true }) {
+        CAnimation animation(assets.getAnimation("Arrow"), true);
+        animation.setFlipped(isFacingLeft);
+
+        CTransform transform;
+        transform.vel.x = 5 * (isFacingLeft ? -1 : 1);
+        transform.scale.x = isFacingLeft ? -1 : 1;
+
+        m_prefabs.add(isFacingLeft ? "EnemyArrowLeft" : "EnemyArrowRight", Tag::EnemyBullet,
+            animation,
+            transform,
+            CBoundingBox(Vec2(10, 10)), // Example size
+            CLifespan(50),
+            CBody(CBody::Kinematic),
+            CAwake());
+    }
+
+    // enemies get their bounding box, patrol range and speed from the level file
+    m_prefabs.add("Enemy", Tag::Enemy,
+        CAnimation(assets.getAnimation("Enemy"), true),
+        CState(),
+        CHealth(100), // Set maximum health
+        CAttackTimer(1.0f),
+        CBody(CBody::Dynamic),
+        CAwake());
+    m_prefabs.add("StrongerEnemy", Tag::StrongerEnemy,
+        CAnimation(assets.getAnimation("StrongerEnemy"), true),
+        CState(),
+        CHealth(10),
+        CAttackTimer(0.5f),
+        CBody(CBody::Dynamic),
+        CAwake());
+
+    // dropped by enemies, unlike the ones placed in the level these can be picked up
+    m_prefabs.add("BottleDrop", Tag::Bottle,
+        CAnimation(assets.getAnimation("Bottle"), true),
+        CTransform(),
+        CBoundingBox(Vec2(20, 20))); // Adjust the size as needed
+    m_prefabs.add("FruitDrop", Tag::Fruit,
+        CAnimation(assets.getAnimation("Fruit"), true),
+        CTransform(),
+        CBoundingBox(Vec2(20, 20)));
+    m_prefabs.add("Key", Tag::Key,
+        CAnimation(assets.getAnimation("Key"), true),
+        CTransform(),
+        CBoundingBox(Vec2(20, 20)));
+}
+
+// prefab for something placed by the level file, made the first time the
+// animation shows up
+const Prefab& Scene_Play::levelPrefab(EntityTag tag, const std::string& animationName) {
+    std::string name = EntityManager::tagName(tag) + "/" + animationName;
+    if (m_prefabs.has(name))
+        return m_prefabs.get(name);
+
+    auto& animation = m_game->assets().getAnimation(animationName);
+    auto& prefab = m_prefabs.add(name, tag, CAnimation(animation, true), CTransform());
+    if (tag == Tag::Tile)
+        prefab.add(CBoundingBox(animation.getSize()));
+    else if (tag == Tag::Coin)
+        prefab.add(CBoundingBox(Vec2(20, 20))); // Adjust the size as needed
+    return prefab;
+}
+
 void Scene_Play::update() {
     if (m_hasEnded) return;
     m_entityManager.update();
@@ -90,6 +234,8 @@ void Scene_Play::update() {
 
     // TODO pause function
 
+    // each system depends on the one before it, the thread pool is used
+    // inside the systems that spread their entities over it
     sMovement();
     sLifespan();
     sCollision();
@@ -101,6 +247,96 @@ void Scene_Play::update() {
     checkWinCondition();
     //updateBackground();
     checkLoseCondition();
+
+    ++m_currentFrame;
+    if constexpr (Deterministic) {
+        if (m_currentFrame % ChecksumInterval == 0)
+            std::cout << "frame " << m_currentFrame << " checksum " << std::hex << checksum() << std::dec << std::endl;
+    }
+}
+
+// FNV-1a over the simulated state of every live entity, in entity order.
+// Two runs of a deterministic build with the same input give the same
+// sequence, so an optimisation can be checked against a reference log.
+uint64_t Scene_Play::checksum() {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const auto& value) {
+        auto bytes = reinterpret_cast<const unsigned char*>(&value);
+        for (size_t i = 0; i < sizeof(value); ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    for (auto e : m_entityManager.getEntities()) {
+        mix(e->getId());
+        mix(e->getTagId());
+        if (e->hasComponent<CTransform>()) {
+            auto& tx = e->getComponent<CTransform>();
+            mix(tx.pos.x); mix(tx.pos.y);
+            mix(tx.vel.x); mix(tx.vel.y);
+        }
+        if (e->hasComponent<CState>())
+            mix(e->getComponent<CState>().state);
+        if (e->hasComponent<CHealth>())
+            mix(e->getComponent<CHealth>().remaining);
+    }
+    mix(collectedCoins);
+    mix(m_playerArrows);
+    return hash;
+}
+
+int Scene_Play::drawLayer(EntityTag tag) const {
+    if (tag == Tag::Tile || tag == Tag::Ground)
+        return DrawLayer::Terrain;
+    if (tag == Tag::Dec)
+        return DrawLayer::Decorations;
+    if (tag == Tag::Enemy || tag == Tag::StrongerEnemy)
+        return DrawLayer::Actors;
+    if (tag == Tag::Bullet || tag == Tag::EnemyBullet)
+        return DrawLayer::Shots;
+    if (tag == Tag::Player)
+        return DrawLayer::Player;
+    return DrawLayer::Props;
+}
+
+// a sprite's box around its entity, turned sprites get the box of any angle
+static Physics::AABB spriteBox(const CAnimation& anim, const CTransform& transform) {
+    Vec2 half(anim.animation.getSize().x * std::abs(transform.scale.x) / 2.f,
+              anim.animation.getSize().y * std::abs(transform.scale.y) / 2.f);
+    if (transform.angle != 0.f)
+        half = Vec2(half.length(), half.length());
+    return Physics::AABB{ Vec2(transform.pos.x - half.x, transform.pos.y - half.y),
+                          Vec2(transform.pos.x + half.x, transform.pos.y + half.y) };
+}
+
+// changes only when a level piece is added or removed, which is when the
+// render index has to be rebuilt
+uint64_t Scene_Play::staticVersion() const {
+    uint64_t version = m_entityManager.version();
+    for (auto tag : MovingTags)
+        version -= m_entityManager.version(tag);
+    return version;
+}
+
+void Scene_Play::drawSprite(Entity& e, CAnimation& anim, CTransform& transform, float alpha) {
+    auto& sprite = anim.animation.getSprite();
+    Vec2 pos = transform.prevPos.lerp(transform.pos, alpha);
+    sprite.setRotation(transform.angle);
+    sprite.setPosition(pos.x, pos.y);
+    sprite.setScale(transform.scale.x, transform.scale.y);
+    m_sprites.add(sprite, drawLayer(e.getTagId()));
+}
+
+// the door and the chest change size when they open, so their place in the
+// render index follows the new sprite
+void Scene_Play::setPieceAnimation(Entity& piece, const std::string& name) {
+    auto& anim = piece.getComponent<CAnimation>();
+    auto& transform = piece.getComponent<CTransform>();
+    auto indexed = spriteBox(anim, transform);
+    anim.animation = m_game->assets().getAnimation(name);
+    if (m_renderIndexVersion == staticVersion())
+        m_renderIndex.move(&piece, indexed, spriteBox(anim, transform));
 }
 
 void Scene_Play::sRender() {
@@ -109,7 +345,13 @@ void Scene_Play::sRender() {
     static const sf::Color pauseBackground(50, 50, 150);
     m_game->window().clear((m_isPaused ? pauseBackground : background));
 
-    auto& pPos = m_player->getComponent<CTransform>().pos;
+    // draw everything where it was between the last two steps, so the
+    // picture moves smoothly whatever the simulation rate
+    float alpha = m_game->renderAlpha();
+    auto renderPos = [alpha](const CTransform& transform) { return transform.prevPos.lerp(transform.pos, alpha); };
+
+    auto player = m_entityManager.get(m_player);
+    Vec2 pPos = renderPos(player->getComponent<CTransform>());
     float centerX = std::max(m_game->window().getSize().x / 2.f, pPos.x);
 
     // Calculate the maximum centerX value
@@ -139,64 +381,90 @@ void Scene_Play::sRender() {
     }
 
     // Ensure the chest's animation is set based on its state
-    if (m_chestOpened) {
-        m_chest->getComponent<CAnimation>().animation = m_game->assets().getAnimation("ChestOpen");
+    auto chest = m_entityManager.get(m_chest);
+    if (m_chestOpened && chest) {
+        setPieceAnimation(*chest, "ChestOpen");
     }
 
     // Ensure the door's animation is set based on its state
-    if (m_doorOpened) {
-        m_door->getComponent<CAnimation>().animation = m_game->assets().getAnimation("DoorTotalOpen");
+    auto door = m_entityManager.get(m_door);
+    if (m_doorOpened && door) {
+        setPieceAnimation(*door, "DoorTotalOpen");
     }
 
-    // Draw all entities except the player
+    // what the camera sees, with a margin for sprites reaching in from outside
+    Physics::AABB visible{ Vec2(view.getCenter().x - view.getSize().x / 2.f, view.getCenter().y - view.getSize().y / 2.f),
+                           Vec2(view.getCenter().x + view.getSize().x / 2.f, view.getCenter().y + view.getSize().y / 2.f) };
+    visible = visible.expanded(Vec2(RenderMargin, RenderMargin));
+
+    // Draw the entities in view, batched into one draw call per layer and
+    // texture; the player is on the top layer so it is in front. Level
+    // pieces come from the render index, so the cost follows what is on
+    // screen rather than the length of the level
     if (m_drawTextures) {
-        for (auto e : m_entityManager.getEntities()) {
-            if (e != m_player && e->hasComponent<CAnimation>()) {
-                auto& transform = e->getComponent<CTransform>();
-                auto& animation = e->getComponent<CAnimation>().animation;
-                animation.getSprite().setRotation(transform.angle);
-                animation.getSprite().setPosition(transform.pos.x, transform.pos.y);
-                animation.getSprite().setScale(transform.scale.x, transform.scale.y);
-                m_game->window().draw(animation.getSprite());
+        if (m_renderIndexVersion != staticVersion()) {
+            m_renderIndex.clear();
+            for (auto [e, anim, transform] : m_entityManager.view<CAnimation, CTransform>()) {
+                if (std::find(std::begin(MovingTags), std::end(MovingTags), e->getTagId()) == std::end(MovingTags))
+                    m_renderIndex.insert(e, spriteBox(anim, transform));
             }
+            m_renderIndexVersion = staticVersion();
         }
-    }
 
-    // Draw the player last to ensure it is in front
-    if (m_drawTextures && m_player->hasComponent<CAnimation>()) {
-        auto& transform = m_player->getComponent<CTransform>();
-        auto& animation = m_player->getComponent<CAnimation>().animation;
-        animation.getSprite().setRotation(transform.angle);
-        animation.getSprite().setPosition(transform.pos.x, transform.pos.y);
-        animation.getSprite().setScale(transform.scale.x, transform.scale.y);
-        m_game->window().draw(animation.getSprite());
-    }
+        m_renderIndex.query(visible, m_visible);
+        for (auto e : m_visible) {
+            auto& anim = e->getComponent<CAnimation>();
+            auto& transform = e->getComponent<CTransform>();
+            if (spriteBox(anim, transform).overlaps(visible))
+                drawSprite(*e, anim, transform, alpha);
+        }
 
-    // Draw collision boxes (debugging)
-    if (m_drawCollision) {
-        for (auto e : m_entityManager.getEntities()) {
-            if (e->hasComponent<CBoundingBox>()) {
-                auto& box = e->getComponent<CBoundingBox>();
+        for (auto tag : MovingTags) {
+            for (auto e : m_entityManager.getEntities(tag)) {
+                if (!e->hasComponents<CAnimation, CTransform>())
+                    continue;
+                auto& anim = e->getComponent<CAnimation>();
                 auto& transform = e->getComponent<CTransform>();
-                sf::RectangleShape rect;
-                rect.setSize(sf::Vector2f(box.size.x, box.size.y));
-                rect.setOrigin(box.size.x / 2.f, box.size.y / 2.f);
-                rect.setPosition(transform.pos.x, transform.pos.y);
-                rect.setFillColor(sf::Color(0, 0, 0, 0));
-                rect.setOutlineColor(sf::Color(255, 0, 0));
-                rect.setOutlineThickness(1.f);
-                m_game->window().draw(rect);
+                if (spriteBox(anim, transform).overlaps(visible))
+                    drawSprite(*e, anim, transform, alpha);
             }
         }
+        m_sprites.draw(m_game->window());
     }
 
-    // Draw health bars for enemies
-    for (auto e : m_entityManager.getEntities("enemy")) {
-        drawHP(e);
+    // Draw collision boxes (debugging)
+    if (m_drawCollision) {
+        for (auto [e, box, transform] : m_entityManager.view<CBoundingBox, CTransform>()) {
+            if (e->getTagId() == Tag::Tile)
+                continue;   // tiles collide as the merged rectangles below
+            sf::RectangleShape rect;
+            rect.setSize(sf::Vector2f(box.size.x, box.size.y));
+            rect.setOrigin(box.size.x / 2.f, box.size.y / 2.f);
+            Vec2 pos = renderPos(transform);
+            rect.setPosition(pos.x, pos.y);
+            rect.setFillColor(sf::Color(0, 0, 0, 0));
+            rect.setOutlineColor(sf::Color(255, 0, 0));
+            rect.setOutlineThickness(1.f);
+            m_game->window().draw(rect);
+        }
+        for (auto& box : m_tileGrid.boxes()) {
+            sf::RectangleShape rect;
+            rect.setSize(sf::Vector2f(box.max.x - box.min.x, box.max.y - box.min.y));
+            rect.setPosition(box.min.x, box.min.y);
+            rect.setFillColor(sf::Color(0, 0, 0, 0));
+            rect.setOutlineColor(sf::Color(255, 0, 0));
+            rect.setOutlineThickness(1.f);
+            m_game->window().draw(rect);
+        }
     }
 
-    for (auto e : m_entityManager.getEntities("stronger_enemy")) {
-        drawHP(e);
+    // Draw health bars for the enemies in view
+    for (auto tag : { Tag::Enemy, Tag::StrongerEnemy }) {
+        for (auto e : m_entityManager.getEntities(tag)) {
+            auto& pos = e->getComponent<CTransform>().pos;
+            if (visible.overlaps({ pos, pos }))
+                drawHP(*e);
+        }
     }
 
     drawLifeSpan();
@@ -251,16 +519,17 @@ void Scene_Play::sRender() {
 
 void Scene_Play::sMovement() {
     // player movement
-    auto& pt = m_player->getComponent<CTransform>();
+    auto player = m_entityManager.get(m_player);
+    auto& pt = player->getComponent<CTransform>();
     pt.vel.x = 0.f;
-    if (m_player->getComponent<CInput>().left)
+    if (player->getComponent<CInput>().left)
         pt.vel.x -= 1;
 
-    if (m_player->getComponent<CInput>().right)
+    if (player->getComponent<CInput>().right)
         pt.vel.x += 1;
 
-    if (m_player->getComponent<CInput>().up) {
-        m_player->getComponent<CInput>().up = false;
+    if (player->getComponent<CInput>().up) {
+        player->getComponent<CInput>().up = false;
         pt.vel.y = -m_playerConfig.JUMP;
     }
 
@@ -270,42 +539,29 @@ void Scene_Play::sMovement() {
 
     // facing direction
     if (pt.vel.x < -0.1)
-        m_player->getComponent<CState>().set(CState::isFacingLeft);
+        player->getComponent<CState>().set(CState::isFacingLeft);
     if (pt.vel.x > 0.1)
-        m_player->getComponent<CState>().unSet(CState::isFacingLeft);
-
-    // move all entities
-    for (auto e : m_entityManager.getEntities()) {
-        auto& tx = e->getComponent<CTransform>();
-        tx.prevPos = tx.pos;
-        tx.pos += tx.vel;
-    }
-
-    // apply gravity to enemies
-    for (auto e : m_entityManager.getEntities("enemy")) {
-        auto& tx = e->getComponent<CTransform>();
-        tx.vel.y += m_playerConfig.GRAVITY;
-    }
-
-	// apply gravity to stronger enemies
-	for (auto e : m_entityManager.getEntities("stronger_enemy")) {
-		auto& tx = e->getComponent<CTransform>();
-		tx.vel.y += m_playerConfig.GRAVITY;
-	}
+        player->getComponent<CState>().unSet(CState::isFacingLeft);
 
+    // apply gravity to enemies of both kinds
+    Systems::applyGravity(m_entityManager, Tag::Enemy, m_playerConfig.GRAVITY);
+    Systems::applyGravity(m_entityManager, Tag::StrongerEnemy, m_playerConfig.GRAVITY);
 
+    // move everything with a body, tiles and other static pieces have none
+    Systems::moveBodies(m_entityManager, m_game->threads());
 }
 
 void Scene_Play::playerCheckState() {
-    auto& tx = m_player->getComponent<CTransform>();
-    auto& state = m_player->getComponent<CState>();
+    auto player = m_entityManager.get(m_player);
+    auto& tx = player->getComponent<CTransform>();
+    auto& state = player->getComponent<CState>();
 
     // face the right way
     if (std::abs(tx.vel.x) > 0.1f)
         tx.scale.x = (tx.vel.x > 0) ? 1 : -1;
 
     if (!state.test(CState::isGrounded)) {
-        m_player->getComponent<CAnimation>().animation = m_game->assets().getAnimation("Air");
+        player->getComponent<CAnimation>().animation = m_game->assets().getAnimation("Air");
     }
     else {
         // if grounded
@@ -313,37 +569,39 @@ void Scene_Play::playerCheckState() {
             if (!state.test(CState::isRunning)) // wasn't running
             {
                 // change to running animation
-                m_player->addComponent<CAnimation>(m_game->assets().getAnimation("Run"), true);
+                player->addComponent<CAnimation>(m_game->assets().getAnimation("Run"), true);
                 state.set(CState::isRunning);
             }
         }
         else {
-            m_player->addComponent<CAnimation>(m_game->assets().getAnimation("Stand"), true);
+            player->addComponent<CAnimation>(m_game->assets().getAnimation("Stand"), true);
             state.unSet(CState::isRunning);
         }
     }
 }
 
-void Scene_Play::respawnPlayer(std::shared_ptr<Entity> player) {
+void Scene_Play::respawnPlayer(Entity& player) {
     // Reset player position to the starting point
-    player->getComponent<CTransform>().pos = gridToMidPixel(m_playerConfig.X, m_playerConfig.Y, player);
-    player->getComponent<CTransform>().vel = Vec2(0.f, 0.f);
+    auto& transform = player.getComponent<CTransform>();
+    transform.pos = transform.prevPos = gridToMidPixel(m_playerConfig.X, m_playerConfig.Y, player);
+    player.getComponent<CTransform>().vel = Vec2(0.f, 0.f);
 
     // Reset player state
-    player->getComponent<CState>().unSet(CState::isGrounded);
-    player->getComponent<CInput>().canJump = true;
-    player->getComponent<CInput>().canShoot = true;
+    player.getComponent<CState>().unSet(CState::isGrounded);
+    player.getComponent<CInput>().canJump = true;
+    player.getComponent<CInput>().canShoot = true;
 }
 
 void Scene_Play::sLifespan() {
     // move all entities
-    for (auto e : m_entityManager.getEntities("bullet")) {
-        auto& lifespan = e->getComponent<CLifespan>();
-        if (lifespan.has) {
+    for (auto e : m_entityManager.getEntities(Tag::Bullet)) {
+        if (e->hasComponent<CLifespan>()) {
+            auto& lifespan = e->getComponent<CLifespan>();
             lifespan.remaining -= 1;
             if (lifespan.remaining < 0) {
-                e->addComponent<CAnimation>(m_game->assets().getAnimation("Explosion"), false);
-                e->getComponent<CLifespan>().has = false;
+                auto& commands = m_entityManager.commands();
+                commands.add(e->getHandle(), CAnimation(m_game->assets().getAnimation("Explosion"), false));
+                commands.remove<CLifespan>(e->getHandle());
                 e->getComponent<CTransform>().vel.x *= 0.1f;
             }
         }
@@ -352,398 +610,185 @@ void Scene_Play::sLifespan() {
 
 void Scene_Play::sCollision() {
     // player with tile
-    auto players = m_entityManager.getEntities("player");
-    auto tiles = m_entityManager.getEntities("tile");
-    auto ground = m_entityManager.getEntities("ground");
-    auto enemies = m_entityManager.getEntities("enemy");
-    auto strongerEnemies = m_entityManager.getEntities("stronger_enemy");
-    auto bullets = m_entityManager.getEntities("bullet");
-    auto enemyBullets = m_entityManager.getEntities("enemy_bullet");
-    auto coins = m_entityManager.getEntities("coin");
-    auto powerUps = m_entityManager.getEntities("Bottle");
-    auto fruits = m_entityManager.getEntities("Fruit");
+    auto& players = m_entityManager.getEntities(Tag::Player);
+    auto& ground = m_entityManager.getEntities(Tag::Ground);
+    auto& enemies = m_entityManager.getEntities(Tag::Enemy);
+    auto& strongerEnemies = m_entityManager.getEntities(Tag::StrongerEnemy);
+    auto& bullets = m_entityManager.getEntities(Tag::Bullet);
+
+    // ground never moves, so it is only hashed again when a piece comes or goes
+    if (m_groundVersion != m_entityManager.version(Tag::Ground)) {
+        m_groundHash.clear();
+        for (auto g : ground)
+            m_groundHash.insert(g);
+        m_groundVersion = m_entityManager.version(Tag::Ground);
+    }
 
-    for (auto p : players) {
-        p->getComponent<CState>().unSet(CState::isGrounded); // not grounded
+    Systems::Terrain terrain{ m_tileGrid, m_groundHash, m_terrainContacts, m_nearbyTerrain, m_terrainHits, m_nearby };
 
+    for (auto p : players) {
         // Update invincibility timer
         if (p->getComponent<CInput>().invincibilityTimer > 0) {
             p->getComponent<CInput>().invincibilityTimer -= m_game->deltaTime();
         }
+        Systems::playerTerrain(*p, terrain);
+    }
 
-        for (auto t : tiles) {
-            auto overlap = Physics::getOverlap(p, t);
-            if (overlap.x > 0 && overlap.y > 0) // +ve overlap in both x and y means collision
-            {
-                auto prevOverlap = Physics::getPreviousOverlap(p, t);
-                auto& ptx = p->getComponent<CTransform>();
-                auto ttx = t->getComponent<CTransform>();
-
-                // collision is in the y direction
-                if (prevOverlap.x > 0) {
-                    if (ptx.prevPos.y < ttx.prevPos.y) {
-                        // player standing on something isGrounded
-                        p->getComponent<CTransform>().pos.y -= overlap.y;
-                        p->getComponent<CInput>().canJump = true;
-                        p->getComponent<CState>().set(CState::isGrounded);
-                    }
-                    else {
-                        // player hit something from below
-                        p->getComponent<CTransform>().pos.y += overlap.y;
-                    }
-                    p->getComponent<CTransform>().vel.y = 0.f;
-                }
+    // enemies of both kinds against the level
+    for (auto e : enemies)
+        Systems::enemyTerrain(*e, terrain);
+    for (auto e : strongerEnemies)
+        Systems::enemyTerrain(*e, terrain);
+    Systems::updateGrounded(m_entityManager, m_terrainContacts);
 
-                // collision is in the x direction
-                if (prevOverlap.y > 0) {
-                    if (ptx.prevPos.x < ttx.prevPos.x) // player left of tile
-                        p->getComponent<CTransform>().pos.x -= overlap.x;
-                    else
-                        p->getComponent<CTransform>().pos.x += overlap.x;
-                }
-            }
-        }
+    // handlers are registered in registerCollisionLayers
+    Systems::dynamicPairs(m_entityManager, m_dynamicPairs, m_collisionLayers);
 
-        // Check collision with the ground
-        for (auto g : ground) {
-            auto overlap = Physics::getOverlap(p, g);
-            if (overlap.x > 0 && overlap.y > 0) {
-                auto prevOverlap = Physics::getPreviousOverlap(p, g);
-                auto& ptx = p->getComponent<CTransform>();
-                auto& gtx = g->getComponent<CTransform>();
-
-                // Y-axis collision (ground)
-                if (prevOverlap.x > 0) {
-                    if (ptx.prevPos.y < gtx.prevPos.y) {  // Player is above ground
-                        ptx.pos.y -= overlap.y;
-                        p->getComponent<CInput>().canJump = true;
-                        p->getComponent<CState>().set(CState::isGrounded);
-                    }
-                    ptx.vel.y = 0.f;
-                }
-            }
-        }
+    // Bullet collision with ground
+    for (auto b : bullets) {
+        if (Systems::hitsGround(*b, terrain))
+            b->destroy(); // Destroy the bullet
+    }
+}
 
-        // Check collision with coins
-        for (auto c : coins) {
-            auto overlap = Physics::getOverlap(p, c);
-            if (overlap.x > 0 && overlap.y > 0) {
-                c->destroy(); // Destroy the coin
-                collectedCoins++;
-            }
+void Scene_Play::onPickup(Entity& p, Entity& pickup) {
+    auto tag = pickup.getTagId();
+    if (tag == Tag::Coin) {
+        collectedCoins++;
+    }
+    else if (tag == Tag::Book) {
+        m_hasBook = true; // Player has the book
+        if (auto door = m_entityManager.get(m_door))
+            setPieceAnimation(*door, "DoorOpen");
+        setMessage("Collected Book", 2.0f);
+    }
+    else if (tag == Tag::Key) {
+        m_hasKey = true; 
+        setMessage("Collected Key", 2.0f);
+    }
+    else if (tag == Tag::Bottle) {
+        // Collect bottle (increase arrows)
+        p.getComponent<CInput>().canShoot = true; // Allow shooting
+        if (m_playerArrows + 3 > 7) {
+            m_playerArrows = 7; // Set to max if it exceeds 10
         }
-
-        // Check collision with the book
-        for (auto b : m_entityManager.getEntities("book")) {
-            auto overlap = Physics::getOverlap(p, b);
-            if (overlap.x > 0 && overlap.y > 0) {
-                m_hasBook = true; // Player has the book
-                m_door->getComponent<CAnimation>().animation = m_game->assets().getAnimation("DoorOpen");
-                b->destroy(); // Destroy the book
-                setMessage("Collected Book", 2.0f);
-            }
+        else {
+            m_playerArrows += 3; // Otherwise, add 3 arrows
         }
-
-        // Check collision with the key
-        for (auto k : m_entityManager.getEntities("key")) {
-            auto overlap = Physics::getOverlap(p, k);
-            if (overlap.x > 0 && overlap.y > 0) {
-                m_hasKey = true; 
-                k->destroy(); 
-                setMessage("Collected Key", 2.0f);
-            }
+        setMessage("Collected Arrow Power-Up", 2.0f);
+    }
+    else if (tag == Tag::Fruit) {
+        // Collect fruit (increase life)
+        auto& playerLifespan = p.getComponent<CLifespan>();
+        if (playerLifespan.total < 5) {
+            playerLifespan.total++;
+            playerLifespan.remaining++;
         }
+        setMessage("Collected Life Power-Up", 2.0f);
+    }
+    pickup.destroy();
+}
 
-        // Check collision with the door
-        for (auto d : m_entityManager.getEntities("door")) {
-            auto overlap = Physics::getOverlap(p, d);
-            if (overlap.x > 0 && overlap.y > 0) {
-                m_door = d; // Store the door entity
-                if (m_hasBook) {
-                    d->getComponent<CAnimation>().animation = m_game->assets().getAnimation("DoorTotalOpen");
-                    setMessage("This door is already opened", 2.0f);
-                }
-                else {
-                    setMessage("You need a key to open this door", 2.0f);
-                }
-            }
+void Scene_Play::onInteractive(Entity&, Entity& thing) {
+    if (thing.getTagId() == Tag::Door) {
+        m_door = thing.getHandle(); // Store the door entity
+        if (m_hasBook) {
+            setPieceAnimation(thing, "DoorTotalOpen");
+            setMessage("This door is already opened", 2.0f);
         }
-
-        // Check collision with the chest
-        for (auto c : m_entityManager.getEntities("chest")) {
-            auto overlap = Physics::getOverlap(p, c);
-            if (overlap.x > 0 && overlap.y > 0) {
-                m_chest = c; 
-                if (m_chestOpened) {
-                    c->getComponent<CAnimation>().animation = m_game->assets().getAnimation("ChestOpen");
-                    setMessage("This chest is already opened", 2.0f);
-                }
-                else if (m_hasKey) {
-                    setMessage("Press 'F' to open the chest", 2.0f);
-                }
-                else {
-                    setMessage("You need a key to open this chest", 2.0f);
-                }
-            }
+        else {
+            setMessage("You need a key to open this door", 2.0f);
         }
-
-        // Check collision with power-ups
-        for (auto pu : powerUps) {
-            auto overlap = Physics::getOverlap(p, pu);
-            if (overlap.x > 0 && overlap.y > 0) {
-                // Collect bottle (increase arrows)
-                p->getComponent<CInput>().canShoot = true; // Allow shooting
-                if (m_playerArrows + 3 > 7) {
-                    m_playerArrows = 7; // Set to max if it exceeds 10
-                }
-                else {
-                    m_playerArrows += 3; // Otherwise, add 3 arrows
-                }
-                pu->destroy(); // Destroy the power-up
-                setMessage("Collected Arrow Power-Up", 2.0f);
-            }
+    }
+    else if (thing.getTagId() == Tag::Chest) {
+        m_chest = thing.getHandle();
+        if (m_chestOpened) {
+            setPieceAnimation(thing, "ChestOpen");
+            setMessage("This chest is already opened", 2.0f);
         }
-
-        // Check collision with fruits
-        for (auto f : fruits) {
-            auto overlap = Physics::getOverlap(p, f);
-            if (overlap.x > 0 && overlap.y > 0) {
-                // Collect fruit (increase life)
-                auto& playerLifespan = p->getComponent<CLifespan>();
-                if (playerLifespan.total < 5) {
-                    playerLifespan.total++;
-                    playerLifespan.remaining++;
-                }
-                f->destroy(); // Destroy the power-up
-                setMessage("Collected Life Power-Up", 2.0f);
-            }
+        else if (m_hasKey) {
+            setMessage("Press 'F' to open the chest", 2.0f);
         }
+        else {
+            setMessage("You need a key to open this chest", 2.0f);
+        }
+    }
+}
 
+void Scene_Play::onEnemyShot(Entity& p, Entity& shot) {
+    auto& playerLifespan = p.getComponent<CLifespan>();
+    playerLifespan.remaining--;
 
-        // Check collision with enemy bullets
-        for (auto eb : enemyBullets) {
-            auto overlap = Physics::getOverlap(p, eb);
-            if (overlap.x > 0 && overlap.y > 0) {
-                auto& playerLifespan = p->getComponent<CLifespan>();
-                playerLifespan.remaining--;
-
-                if (playerLifespan.remaining <= 0) {
-                    p->destroy();
-                    onEnd();
-                }
-                else {
-                    p->getComponent<CTransform>().vel.y = 5.f;
-                    p->getComponent<CAnimation>().animation = m_game->assets().getAnimation("PlayerHurt");
-                }
-                eb->destroy(); // Destroy the enemy bullet
-            }
-        }
+    if (playerLifespan.remaining <= 0) {
+        p.destroy();
+        onEnd();
+    }
+    else {
+        p.getComponent<CTransform>().vel.y = 5.f;
+        p.getComponent<CAnimation>().animation = m_game->assets().getAnimation("PlayerHurt");
     }
+    shot.destroy(); // Destroy the enemy bullet
+}
 
-    for (auto e : enemies) {
-        e->getComponent<CState>().unSet(CState::isGrounded);
-        for (auto t : tiles) {
-            auto overlap = Physics::getOverlap(e, t);
-            if (overlap.x > 0 && overlap.y > 0) {
-                auto prevOverlap = Physics::getPreviousOverlap(e, t);
-                auto& etx = e->getComponent<CTransform>();
-                auto ttx = t->getComponent<CTransform>();
-
-                if (prevOverlap.x > 0) {
-                    if (etx.prevPos.y < ttx.prevPos.y) {
-                        etx.pos.y -= overlap.y;
-                        e->getComponent<CState>().set(CState::isGrounded);
-                    }
-                    else {
-                        etx.pos.y += overlap.y;
-                    }
-                    etx.vel.y = 0.f;
+void Scene_Play::onPlayerShot(Entity& b, Entity& e) {
+    auto& enemyHealth = e.getComponent<CHealth>();
+    enemyHealth.remaining -= 10; // Reduce health
+    enemyHealth.hurtTimer = 1.0f; // Set hurt timer 
+    if (e.getTagId() == Tag::Enemy) {
+        if (enemyHealth.remaining <= 0) {
+            e.destroy();
+
+            // Spawn power-ups with a probability check
+            // the top 24 bits make an exact float in [0, 1) on every platform
+            if ((m_random() >> 8) * (1.f / 16777216.f) < POWER_UP_DROP_PROBABILITY) {
+                Vec2 position = e.getComponent<CTransform>().pos;
+                if (m_random() % 2 == 0) {
+                    spawnPowerUp(position, "Bottle");
                 }
-            }
-        }
-
-        // Check collision with the ground
-        for (auto g : ground) {
-            auto overlap = Physics::getOverlap(e, g);
-            if (overlap.x > 0 && overlap.y > 0) {
-                auto prevOverlap = Physics::getPreviousOverlap(e, g);
-                auto& etx = e->getComponent<CTransform>();
-                auto& gtx = g->getComponent<CTransform>();
-
-                if (prevOverlap.x > 0) {
-                    if (etx.prevPos.y < gtx.prevPos.y) {
-                        etx.pos.y -= overlap.y;
-                        e->getComponent<CState>().set(CState::isGrounded);
-                    }
-                    else {
-                        etx.pos.y += overlap.y;
-                    }
-                    etx.vel.y = 0.f;
+                else {
+                    spawnPowerUp(position, "Fruit");
                 }
             }
         }
-
-        // Check collision with bullets
-        for (auto b : bullets) {
-            for (auto e : enemies) {
-                auto overlap = Physics::getOverlap(e, b);
-                if (overlap.x > 0 && overlap.y > 0) {
-                    auto& enemyHealth = e->getComponent<CHealth>();
-                    enemyHealth.remaining -= 10;
-                    enemyHealth.hurtTimer = 1.0f; 
-                    if (enemyHealth.remaining <= 0) {
-                        e->destroy();
-
-                        // Spawn power-ups with a probability check
-                        if (static_cast<float>(rand()) / RAND_MAX < POWER_UP_DROP_PROBABILITY) {
-                            Vec2 position = e->getComponent<CTransform>().pos;
-                            if (rand() % 2 == 0) {
-                                spawnPowerUp(position, "Bottle");
-                            }
-                            else {
-                                spawnPowerUp(position, "Fruit");
-                            }
-                        }
-                    }
-                    else {
-                        e->getComponent<CAnimation>().animation = m_game->assets().getAnimation("Hurt");
-                    }
-                    b->destroy();
-                }
-            }
+        else {
+            e.getComponent<CAnimation>().animation = m_game->assets().getAnimation("Hurt");
         }
     }
+    else {
+        if (enemyHealth.remaining <= 0) {
+            // Capture the position before destroying the enemy
+            Vec2 position = e.getComponent<CTransform>().pos;
 
-    // Check collision with stronger enemies
-    for (auto e : strongerEnemies) {
-        e->getComponent<CState>().unSet(CState::isGrounded);
-        for (auto t : tiles) {
-            auto overlap = Physics::getOverlap(e, t);
-            if (overlap.x > 0 && overlap.y > 0) {
-                auto prevOverlap = Physics::getPreviousOverlap(e, t);
-                auto& etx = e->getComponent<CTransform>();
-                auto ttx = t->getComponent<CTransform>();
-
-                if (prevOverlap.x > 0) {
-                    if (etx.prevPos.y < ttx.prevPos.y) {
-                        etx.pos.y -= overlap.y;
-                        e->getComponent<CState>().set(CState::isGrounded);
-                    }
-                    else {
-                        etx.pos.y += overlap.y;
-                    }
-                    etx.vel.y = 0.f;
-                }
-            }
-        }
+            // Stronger enemy dies
+            e.destroy();
 
-        // Check collision with the ground
-        for (auto g : ground) {
-            auto overlap = Physics::getOverlap(e, g);
-            if (overlap.x > 0 && overlap.y > 0) {
-                auto prevOverlap = Physics::getPreviousOverlap(e, g);
-                auto& etx = e->getComponent<CTransform>();
-                auto& gtx = g->getComponent<CTransform>();
-
-                if (prevOverlap.x > 0) {
-                    if (etx.prevPos.y < gtx.prevPos.y) {
-                        etx.pos.y -= overlap.y;
-                        e->getComponent<CState>().set(CState::isGrounded);
-                    }
-                    else {
-                        etx.pos.y += overlap.y;
-                    }
-                    etx.vel.y = 0.f;
-                }
-            }
+            // Drop a key at the captured position
+            spawnKey(position);
         }
-
-        // Check collision with bullets
-        for (auto b : bullets) {
-            auto overlap = Physics::getOverlap(e, b);
-            if (overlap.x > 0 && overlap.y > 0) {
-                auto& enemyHealth = e->getComponent<CHealth>();
-                enemyHealth.remaining -= 10; // Reduce health
-                enemyHealth.hurtTimer = 1.0f; // Set hurt timer 
-                if (enemyHealth.remaining <= 0) {
-                    // Capture the position before destroying the enemy
-                    Vec2 position = e->getComponent<CTransform>().pos;
-
-                    // Stronger enemy dies
-                    e->destroy();
-
-                    // Drop a key at the captured position
-                    spawnKey(position);
-                }
-                else {
-                    e->getComponent<CAnimation>().animation = m_game->assets().getAnimation("ArcherHurt");
-                }
-                b->destroy(); // Destroy the bullet
-            }
+        else {
+            e.getComponent<CAnimation>().animation = m_game->assets().getAnimation("ArcherHurt");
         }
     }
+    b.destroy(); // Destroy the bullet
+}
 
-    // Player collision with enemies
-    for (auto p : players) {
-        for (auto e : enemies) {
-            auto overlap = Physics::getOverlap(p, e);
-            if (overlap.x > 0 && overlap.y > 0) {
-                auto& playerLifespan = p->getComponent<CLifespan>();
-                auto& playerInput = p->getComponent<CInput>();
-
-                // Check if the invincibility timer has expired
-                if (playerInput.invincibilityTimer <= 0) {
-                    playerLifespan.remaining--;
-                    playerInput.invincibilityTimer = 1.0f;
-
-                    if (playerLifespan.remaining <= 0) {
-                        p->destroy();
-                        onEnd();
-                    }
-                    else {
-                        // Apply knockback effect
-                        p->getComponent<CTransform>().vel.y = 5.f;
-                        p->getComponent<CAnimation>().animation = m_game->assets().getAnimation("PlayerHurt");
-                    }
-                }
-            }
-        }
-    }
+void Scene_Play::onEnemyContact(Entity& p, Entity&) {
+    auto& playerLifespan = p.getComponent<CLifespan>();
+    auto& playerInput = p.getComponent<CInput>();
 
-    // Player collision with stronger enemies
-    for (auto p : players) {
-        for (auto e : strongerEnemies) {
-            auto overlap = Physics::getOverlap(p, e);
-            if (overlap.x > 0 && overlap.y > 0) {
-                auto& playerLifespan = p->getComponent<CLifespan>();
-                auto& playerInput = p->getComponent<CInput>();
-
-                // Check if the invincibility timer has expired
-                if (playerInput.invincibilityTimer <= 0) {
-                    playerLifespan.remaining--;
-                    playerInput.invincibilityTimer = 1.0f;
-
-                    if (playerLifespan.remaining <= 0) {
-                        p->destroy();
-                        onEnd();
-                    }
-                    else {
-                        // Apply knockback effect
-                        p->getComponent<CTransform>().vel.y = 5.f;
-                        p->getComponent<CAnimation>().animation = m_game->assets().getAnimation("PlayerHurt");
-                    }
-                }
-            }
-        }
-    }
+    // Check if the invincibility timer has expired
+    if (playerInput.invincibilityTimer <= 0) {
+        playerLifespan.remaining--;
+        playerInput.invincibilityTimer = 1.0f;
 
-    // Bullet collision with ground
-    for (auto b : bullets) {
-        for (auto g : ground) {
-            auto overlap = Physics::getOverlap(b, g);
-            if (overlap.x > 0 && overlap.y > 0) {
-                b->destroy(); // Destroy the bullet
-            }
+        if (playerLifespan.remaining <= 0) {
+            p.destroy();
+            onEnd();
+        }
+        else {
+            // Apply knockback effect
+            p.getComponent<CTransform>().vel.y = 5.f;
+            p.getComponent<CAnimation>().animation = m_game->assets().getAnimation("PlayerHurt");
         }
     }
 }
@@ -764,6 +809,8 @@ void Scene_Play::sDoAction(const Action& action) {
         return;
     }
 
+    auto player = m_entityManager.get(m_player);
+
     // On Key Press
     if (action.type() == "START") {
         if (action.name() == "TOGGLE_TEXTURE") { m_drawTextures = !m_drawTextures; }
@@ -773,33 +820,34 @@ void Scene_Play::sDoAction(const Action& action) {
         else if (action.name() == "QUIT") { onEnd(); }
 
         // Player control
-        else if (action.name() == "LEFT") { m_player->getComponent<CInput>().left = true; }
-        else if (action.name() == "RIGHT") { m_player->getComponent<CInput>().right = true; }
+        else if (action.name() == "LEFT") { player->getComponent<CInput>().left = true; }
+        else if (action.name() == "RIGHT") { player->getComponent<CInput>().right = true; }
         else if (action.name() == "JUMP") {
-            if (m_player->getComponent<CInput>().canJump && m_player->getComponent<CState>().test(CState::isGrounded)) {
-                m_player->getComponent<CInput>().up = true;
-                m_player->getComponent<CInput>().canJump = false;
+            if (player->getComponent<CInput>().canJump && player->getComponent<CState>().test(CState::isGrounded)) {
+                player->getComponent<CInput>().up = true;
+                player->getComponent<CInput>().canJump = false;
             }
         }
         else if (action.name() == "SHOOT") {
-            if (m_player->getComponent<CInput>().canShoot) {
-                spawnBullet(m_player);
-                m_player->getComponent<CInput>().shoot = true;
-                m_player->getComponent<CInput>().canShoot = false;
+            if (player->getComponent<CInput>().canShoot) {
+                spawnBullet(*player);
+                player->getComponent<CInput>().shoot = true;
+                player->getComponent<CInput>().canShoot = false;
             }
         }
         else if (action.name() == "INTERACT") {
-            if (m_chest && !m_chestOpened) {
+            auto chest = m_entityManager.get(m_chest);
+            if (chest && !m_chestOpened) {
                 // Open the chest and collect the book
                 m_chestOpened = true;
-                m_chest->getComponent<CAnimation>().animation = m_game->assets().getAnimation("ChestOpen"); // Change chest animation to open
-                spawnBook(m_chest->getComponent<CTransform>().pos); // Spawn the book at the chest's position
+                setPieceAnimation(*chest, "ChestOpen"); // Change chest animation to open
+                spawnBook(chest->getComponent<CTransform>().pos); // Spawn the book at the chest's position
                 std::cout << "Opened Chest and Collected Book." << std::endl;
             }
             else if (m_hasBook) {
                 // Open the door
                 m_doorOpened = true; // Set the door as opened
-                m_door->getComponent<CAnimation>().animation = m_game->assets().getAnimation("DoorTotalOpen"); // Change door animation to open
+                setPieceAnimation(*m_entityManager.get(m_door), "DoorTotalOpen"); // Change door animation to open
                 std::cout << "Door opened." << std::endl;
                 checkWinCondition(); // Check win condition after opening the door
             }
@@ -808,36 +856,28 @@ void Scene_Play::sDoAction(const Action& action) {
 
     // On Key Release
     else if (action.type() == "END") {
-        if (action.name() == "LEFT") { m_player->getComponent<CInput>().left = false; }
-        else if (action.name() == "RIGHT") { m_player->getComponent<CInput>().right = false; }
-        else if (action.name() == "JUMP") { m_player->getComponent<CInput>().up = false; }
-        else if (action.name() == "SHOOT") { m_player->getComponent<CInput>().canShoot = true; }
+        if (action.name() == "LEFT") { player->getComponent<CInput>().left = false; }
+        else if (action.name() == "RIGHT") { player->getComponent<CInput>().right = false; }
+        else if (action.name() == "JUMP") { player->getComponent<CInput>().up = false; }
+        else if (action.name() == "SHOOT") { player->getComponent<CInput>().canShoot = true; }
     }
 }
 
 void Scene_Play::sAnimation() {
-    for (auto e : m_entityManager.getEntities()) {
-        auto& anim = e->getComponent<CAnimation>();
-        if (anim.has) {
-            anim.animation.update(anim.repeat);
-            if (anim.animation.hasEnded())
-                e->destroy();
-        }
-
-        // Check if the entity has a health component and update the hurt timer
-        if (e->hasComponent<CHealth>()) {
-            auto& health = e->getComponent<CHealth>();
-            if (health.hurtTimer > 0) {
-                health.hurtTimer -= m_game->deltaTime();
-                if (health.hurtTimer <= 0) {
-                    // Revert to the original animation after the hurt timer expires
-                    if (e->hasComponent<CAnimation>()) {
-                        if (e->getComponent<CAnimation>().animation.getName() == "ArcherHurt") {
-                            e->getComponent<CAnimation>().animation = m_game->assets().getAnimation("StrongerEnemy");
-                        }
-                        else {
-                            e->getComponent<CAnimation>().animation = m_game->assets().getAnimation("Enemy");
-                        }
+    Systems::advanceAnimations(m_entityManager, m_game->threads());
+
+    // Update the hurt timer of everything that has health
+    for (auto [e, health] : m_entityManager.view<CHealth>()) {
+        if (health.hurtTimer > 0) {
+            health.hurtTimer -= m_game->deltaTime();
+            if (health.hurtTimer <= 0) {
+                // Revert to the original animation after the hurt timer expires
+                if (e->hasComponent<CAnimation>()) {
+                    if (e->getComponent<CAnimation>().animation.getName() == "ArcherHurt") {
+                        e->getComponent<CAnimation>().animation = m_game->assets().getAnimation("StrongerEnemy");
+                    }
+                    else {
+                        e->getComponent<CAnimation>().animation = m_game->assets().getAnimation("Enemy");
                     }
                 }
             }
@@ -852,15 +892,16 @@ void Scene_Play::onEnd() {
 void Scene_Play::drawLine() {
 }
 
-void Scene_Play::drawHP(std::shared_ptr<Entity> e) {
-    auto& health = e->getComponent<CHealth>();
-    auto& tx = e->getComponent<CTransform>();
+void Scene_Play::drawHP(Entity& e) {
+    auto& health = e.getComponent<CHealth>();
+    auto& tx = e.getComponent<CTransform>();
+    Vec2 pos = tx.prevPos.lerp(tx.pos, m_game->renderAlpha());  // follow the interpolated sprite
 
     // Create the health bar
     sf::RectangleShape hpBar;
     hpBar.setSize(sf::Vector2f(health.remaining * 0.5f, 5)); 
     hpBar.setFillColor(sf::Color::Red);
-    hpBar.setPosition(tx.pos.x - 25, tx.pos.y - 40); // Higher position
+    hpBar.setPosition(pos.x - 25, pos.y - 40); // Higher position
 
     // Create the health text
     sf::Text hpText;
@@ -868,7 +909,7 @@ void Scene_Play::drawHP(std::shared_ptr<Entity> e) {
     hpText.setString(std::to_string(health.remaining) + "/100");
     hpText.setCharacterSize(10); 
     hpText.setFillColor(sf::Color::White);
-    hpText.setPosition(tx.pos.x - 25, tx.pos.y - 50); // Higher position
+    hpText.setPosition(pos.x - 25, pos.y - 50); // Higher position
 
     // Draw the health bar and text
     m_game->window().draw(hpBar);
@@ -905,8 +946,9 @@ void Scene_Play::drawLifeSpan() {
     sf::Vector2f viewSize = m_game->window().getView().getSize();
 
     // Draw hearts for health
-    int totalHealth = m_player->getComponent<CLifespan>().total;
-    int remainingHealth = m_player->getComponent<CLifespan>().remaining;
+    auto player = m_entityManager.get(m_player);
+    int totalHealth = player->getComponent<CLifespan>().total;
+    int remainingHealth = player->getComponent<CLifespan>().remaining;
 
     // Adjust the spacing between hearts
     float heartSpacing = 40.0f; // Increase this value to add more space between hearts
@@ -973,25 +1015,34 @@ void Scene_Play::drawWinScreen()
 void Scene_Play::sDebug() {
 }
 
-Vec2 Scene_Play::gridToMidPixel(float gridX, float gridY, std::shared_ptr<Entity> entity) {
+Vec2 Scene_Play::gridToMidPixel(float gridX, float gridY, const Entity& entity) {
     // (left, bot) of grix,gidy)
 
     // this is for side scroll, and based on window height being the same as world height
     // to be more generic and support scrolling up and down as well as left and right it
     // should be based on world size not window size
+    return gridToMidPixel(gridX, gridY, entity.getComponent<CAnimation>().animation.getSize());
+}
+
+Vec2 Scene_Play::gridToMidPixel(float gridX, float gridY, const Vec2& spriteSize) {
     float x = 0.f + gridX * m_gridSize.x;
     float y = 768.f - gridY * m_gridSize.y;
 
-    Vec2 spriteSize = entity->getComponent<CAnimation>().animation.getSize();
-
     return Vec2(x + spriteSize.x / 2.f, y - spriteSize.y / 2.f);
 }
 
 void Scene_Play::loadLevel(const std::string& path) {
     m_entityManager = EntityManager(); 
+    m_dynamicPairs.clear();
+    m_terrainContacts.clear();
+    m_renderIndexVersion = UINT64_MAX;    // new entities, same version numbers
+    m_groundVersion = UINT64_MAX;
+    m_random.seed(Deterministic ? RandomSeed : std::random_device{}());
+    m_currentFrame = 0;
 
     // TODO read in level file
     loadFromFile(path);
+    registerPrefabs();
 
     spawnPlayer();
 	spawnEnemy(m_enemyConfigs);
@@ -1022,26 +1073,41 @@ void Scene_Play::loadFromFile(const std::string& path) {
     std::string token{ "" };
     std::vector<EnemyConfig> enemyConfigs;
     std::vector<EnemyConfig> strongerEnemyConfigs;
+
+    // consecutive placements of the same prefab are stamped in one go,
+    // the run is flushed whenever the prefab changes so file order is kept
+    const Prefab* runPrefab = nullptr;
+    std::vector<Vec2> runPositions;
+    std::vector<Entity*> levelTiles;
+    auto flushRun = [&]() {
+        if (runPrefab) {
+            auto placed = m_entityManager.instantiate(*runPrefab, runPositions.size(), runPositions);
+            if (runPrefab->tag == Tag::Tile)
+                levelTiles.insert(levelTiles.end(), placed.begin(), placed.end());
+        }
+        runPositions.clear();
+    };
+    auto place = [&](const Prefab& prefab, float gx, float gy) {
+        if (&prefab != runPrefab) {
+            flushRun();
+            runPrefab = &prefab;
+        }
+        runPositions.push_back(gridToMidPixel(gx, gy, prefab.get<CAnimation>()->animation.getSize()));
+    };
+
     confFile >> token;
     while (confFile) {
         if (token == "Tile") {
             std::string name;
             float gx, gy;
             confFile >> name >> gx >> gy;
-
-            auto e = m_entityManager.addEntity("tile");
-            e->addComponent<CAnimation>(m_game->assets().getAnimation(name), true);
-            e->addComponent<CBoundingBox>(m_game->assets().getAnimation(name).getSize());
-            e->addComponent<CTransform>(gridToMidPixel(gx, gy, e));
+            place(levelPrefab(Tag::Tile, name), gx, gy);
         }
         else if (token == "Dec") {
             std::string name;
             float gx, gy;
             confFile >> name >> gx >> gy;
-
-            auto e = m_entityManager.addEntity("dec");
-            e->addComponent<CAnimation>(m_game->assets().getAnimation(name), true);
-            e->addComponent<CTransform>(gridToMidPixel(gx, gy, e));
+            place(levelPrefab(Tag::Dec, name), gx, gy);
         }
         else if (token == "Player") {
             confFile >>
@@ -1094,32 +1160,22 @@ void Scene_Play::loadFromFile(const std::string& path) {
         else if (token == "Coin") {
             float gx, gy;
             confFile >> gx >> gy;
-
-            auto coin = m_entityManager.addEntity("coin");
-            coin->addComponent<CAnimation>(m_game->assets().getAnimation("Coin"), true);
-            coin->addComponent<CTransform>(gridToMidPixel(gx, gy, coin));
-            coin->addComponent<CBoundingBox>(Vec2(20, 20)); // Adjust the size as needed
+            place(levelPrefab(Tag::Coin, "Coin"), gx, gy);
         }
         else if (token == "Arrow") {
             float gx, gy;
             confFile >> gx >> gy;
-            auto arrow = m_entityManager.addEntity("arrow");
-            arrow->addComponent<CAnimation>(m_game->assets().getAnimation("Arrow"), true);
-            arrow->addComponent<CTransform>(gridToMidPixel(gx, gy, arrow));
+            place(levelPrefab(Tag::Arrow, "Arrow"), gx, gy);
         }
         else if (token == "Bottle") {
             float gx, gy;
             confFile >> gx >> gy;
-            auto bottle = m_entityManager.addEntity("Bottle");
-            bottle->addComponent<CAnimation>(m_game->assets().getAnimation("Bottle"), true);
-            bottle->addComponent<CTransform>(gridToMidPixel(gx, gy, bottle));
+            place(levelPrefab(Tag::Bottle, "Bottle"), gx, gy);
         }
         else if (token == "Fruit") {
             float gx, gy;
             confFile >> gx >> gy;
-            auto fruit = m_entityManager.addEntity("Fruit");
-            fruit->addComponent<CAnimation>(m_game->assets().getAnimation("Fruit"), true);
-            fruit->addComponent<CTransform>(gridToMidPixel(gx, gy, fruit));
+            place(levelPrefab(Tag::Fruit, "Fruit"), gx, gy);
         }
         else if (token == "#") {
             std::string tmp;
@@ -1132,61 +1188,45 @@ void Scene_Play::loadFromFile(const std::string& path) {
 
         confFile >> token;
     }
+    flushRun();
+    m_tileGrid.build(levelTiles);
 
     m_enemyConfigs = enemyConfigs;
     m_strongerEnemyConfigs = strongerEnemyConfigs;
 }
 
 void Scene_Play::spawnPlayer() {
-    m_player = m_entityManager.addEntity("player");
-    m_player->addComponent<CAnimation>(m_game->assets().getAnimation("Run"), true);
-    m_player->addComponent<CTransform>(gridToMidPixel(m_playerConfig.X, m_playerConfig.Y, m_player));
-    m_player->addComponent<CBoundingBox>(Vec2(m_playerConfig.CW, m_playerConfig.CH));
-    m_player->addComponent<CState>();
-    m_player->addComponent<CLifespan>(3);
+    auto player = m_entityManager.addEntity(Tag::Player);
+    m_player = player->getHandle();
+    player->addComponent<CAnimation>(m_game->assets().getAnimation("Run"), true);
+    player->addComponent<CTransform>(gridToMidPixel(m_playerConfig.X, m_playerConfig.Y, *player));
+    player->addComponent<CBoundingBox>(Vec2(m_playerConfig.CW, m_playerConfig.CH));
+    player->addComponent<CState>();
+    player->addComponent<CInput>();
+    player->addComponent<CLifespan>(3);
+    player->addComponent<CBody>(CBody::Kinematic);  // steered every step, never sleeps
+    player->addComponent<CAwake>();
 }
 
-void Scene_Play::spawnBullet(std::shared_ptr<Entity> e) {
+void Scene_Play::spawnBullet(Entity& e) {
     if (m_playerArrows > 0) { // Check if the player has arrows
-        auto tx = e->getComponent<CTransform>();
-
-        if (tx.has) {
-            auto bullet = m_entityManager.addEntity("bullet");
-            bullet->addComponent<CAnimation>(m_game->assets().getAnimation(m_playerConfig.WEAPON), true);
-            bullet->addComponent<CTransform>(tx.pos);
-
-            // Set a smaller bounding box for the arrow
-            Vec2 arrowSize = m_game->assets().getAnimation(m_playerConfig.WEAPON).getSize();
-            Vec2 smallerSize = Vec2(arrowSize.x * 0.5f, arrowSize.y * 0.5f); // Adjust the size as needed
-            bullet->addComponent<CBoundingBox>(smallerSize);
-
-            bool isFacingLeft = e->getComponent<CState>().test(CState::isFacingLeft);
+        if (e.hasComponent<CTransform>()) {
+            auto tx = e.getComponent<CTransform>();
+            bool isFacingLeft = e.getComponent<CState>().test(CState::isFacingLeft);
             std::cout << "Bullet facing left: " << isFacingLeft << std::endl;
 
-            // Flip the animation
-            bullet->getComponent<CAnimation>().setFlipped(isFacingLeft);
-
-            // Increase the velocity of the arrow
-            bullet->getComponent<CTransform>().vel.x = 15 * (isFacingLeft ? -1 : 1); // Increase velocity to 15 (or any other value)
-            bullet->getComponent<CTransform>().vel.y = 0;
-
-            // Set the scale based on the velocity
-            if (std::abs(bullet->getComponent<CTransform>().vel.x) > 0.1f) {
-                bullet->getComponent<CTransform>().scale.x = (bullet->getComponent<CTransform>().vel.x > 0) ? 1 : -1;
-            }
-
-            // Add a lifespan component to limit the range of the bullet
-            bullet->addComponent<CLifespan>(15); // Adjust the lifespan value as needed
+            auto& prefab = m_prefabs.get(isFacingLeft ? "PlayerArrowLeft" : "PlayerArrowRight");
+            m_entityManager.instantiate(prefab, 1, { &tx.pos, 1 });
 
             m_playerArrows--; // Decrease the number of arrows
         }
     }
 }
 
-bool Scene_Play::checkPlatformEdge(std::shared_ptr<Entity> enemy) {
-    auto& transform = enemy->getComponent<CTransform>();
-    auto& boundingBox = enemy->getComponent<CBoundingBox>();
-    auto& platformInfo = enemy->getComponent<CPlatformInfo>();
+bool Scene_Play::checkPlatformEdge(Entity& enemy) {
+    auto& transform = enemy.getComponent<CTransform>();
+    auto& boundingBox = enemy.getComponent<CBoundingBox>();
+    auto& platformInfo = enemy.getComponent<CPlatformInfo>();
 
     float edgeThreshold = 5.0f;
 
@@ -1219,18 +1259,23 @@ void Scene_Play::checkWinCondition() {
 }
 
 void Scene_Play::spawnEnemy(const std::vector<EnemyConfig>& configs) {
+    auto& prefab = m_prefabs.get("Enemy");
+    Vec2 spriteSize = prefab.get<CAnimation>()->animation.getSize();
+
+    std::vector<Vec2> positions;
     for (const auto& config : configs) {
-        auto enemy = m_entityManager.addEntity("enemy");
-        enemy->addComponent<CAnimation>(m_game->assets().getAnimation("Enemy"), true);
+        positions.push_back(gridToMidPixel(config.X, config.Y, spriteSize));
+    }
+
+    auto enemies = m_entityManager.instantiate(prefab, configs.size(), positions);
+    for (size_t i = 0; i < configs.size(); ++i) {
+        const auto& config = configs[i];
+        auto enemy = enemies[i];
         enemy->addComponent<CBoundingBox>(Vec2(config.CW, config.CH));
-        enemy->addComponent<CState>();
         enemy->addComponent<CPlatformInfo>(config.platformStartX, config.platformEndX);
-        enemy->addComponent<CHealth>(100); // Set maximum health
-        enemy->addComponent<CAttackTimer>(1.0f);
 
-        Vec2 pos = gridToMidPixel(config.X, config.Y, enemy);
+        Vec2 pos = positions[i];
         std::cout << "Converted position: " << pos.x << ", " << pos.y << std::endl;
-        enemy->addComponent<CTransform>(pos);
 
         auto& transform = enemy->getComponent<CTransform>();
         transform.vel.x = config.SPEED;
@@ -1240,16 +1285,16 @@ void Scene_Play::spawnEnemy(const std::vector<EnemyConfig>& configs) {
             << " with weapon: " << config.WEAPON << std::endl;
 
         // Store the respawn point for the enemy
-        m_enemyRespawnPoints[enemy] = pos;
+        m_enemyRespawnPoints[enemy->getHandle()] = pos;
     }
 }
 
-void Scene_Play::respawnEnemy(std::shared_ptr<Entity> enemy) {
-    auto& transform = enemy->getComponent<CTransform>();
-    transform.pos = m_enemyRespawnPoints[enemy];
+void Scene_Play::respawnEnemy(Entity& enemy) {
+    auto& transform = enemy.getComponent<CTransform>();
+    transform.pos = transform.prevPos = m_enemyRespawnPoints[enemy.getHandle()];
     transform.vel = Vec2(0.f, 0.f);
 
-    if (enemy->getComponent<CAnimation>().animation.getName() == "StrongerEnemy") {
+    if (enemy.getComponent<CAnimation>().animation.getName() == "StrongerEnemy") {
         std::cout << "Respawned stronger enemy at: " << transform.pos.x << ", " << transform.pos.y << std::endl;
     }
     else {
@@ -1260,7 +1305,7 @@ void Scene_Play::respawnEnemy(std::shared_ptr<Entity> enemy) {
 void Scene_Play::checkLoseCondition() {
     if (m_hasEnded) return;
 
-    auto players = m_entityManager.getEntities("player");
+    auto& players = m_entityManager.getEntities(Tag::Player);
     for (auto& player : players) {
         auto& playerTransform = player->getComponent<CTransform>();
 
@@ -1274,73 +1319,72 @@ void Scene_Play::checkLoseCondition() {
                 onEnd();
             }
             else {
-                respawnPlayer(player);
+                respawnPlayer(*player);
             }
         }
     }
 
-    auto enemies = m_entityManager.getEntities("enemy");
+    auto& enemies = m_entityManager.getEntities(Tag::Enemy);
     for (auto& enemy : enemies) {
         auto& enemyTransform = enemy->getComponent<CTransform>();
 
         // Check if the enemy has fallen off the screen
         if (enemyTransform.pos.y > m_game->window().getSize().y) {
-            respawnEnemy(enemy);
+            respawnEnemy(*enemy);
         }
     }
 
-    auto strongerEnemies = m_entityManager.getEntities("stronger_enemy");
+    auto& strongerEnemies = m_entityManager.getEntities(Tag::StrongerEnemy);
     for (auto& enemy : strongerEnemies) {
         auto& enemyTransform = enemy->getComponent<CTransform>();
 
         // Check if the stronger enemy has fallen off the screen
         if (enemyTransform.pos.y > m_game->window().getSize().y) {
-            respawnEnemy(enemy);
+            respawnEnemy(*enemy);
         }
     }
 }
 
-void Scene_Play::meleeAttack(std::shared_ptr<Entity> enemy) {
+void Scene_Play::meleeAttack(Entity& enemy) {
     // Implement melee attack logic
     std::cout << "Enemy performs melee attack!" << std::endl;
     // Example: Reduce player's health
-    auto players = m_entityManager.getEntities("player");
+    auto& players = m_entityManager.getEntities(Tag::Player);
     for (auto p : players) {
         auto& ptx = p->getComponent<CTransform>();
-        auto& etx = enemy->getComponent<CTransform>();
+        auto& etx = enemy.getComponent<CTransform>();
         float distance = std::abs(etx.pos.x - ptx.pos.x);
-        if (distance < 50) { // Example melee range
+        if (distance < 50 && p->hasComponent<CHealth>()) { // Example melee range
             auto& playerHealth = p->getComponent<CHealth>();
             playerHealth.remaining -= 10; // Reduce player's health
         }
     }
 }
 
-void Scene_Play::rangedAttack(std::shared_ptr<Entity> enemy) {
+void Scene_Play::rangedAttack(Entity& enemy) {
     // Implement ranged attack logic
     std::cout << "Enemy performs ranged attack!" << std::endl;
     // Example: Spawn an enemy bullet entity
-    auto& etx = enemy->getComponent<CTransform>();
-    auto enemyBullet = m_entityManager.addEntity("enemy_bullet");
-    enemyBullet->addComponent<CAnimation>(m_game->assets().getAnimation("Arrow"), true);
-    enemyBullet->addComponent<CTransform>(etx.pos);
-    enemyBullet->addComponent<CBoundingBox>(Vec2(10, 10)); // Example size
-    enemyBullet->addComponent<CLifespan>(50);
-
-    bool isFacingLeft = enemy->getComponent<CState>().test(CState::isFacingLeft);
-    enemyBullet->getComponent<CAnimation>().setFlipped(isFacingLeft);
-
-    enemyBullet->getComponent<CTransform>().vel.x = 5 * (isFacingLeft ? -1 : 1);
-    enemyBullet->getComponent<CTransform>().vel.y = 0;
-
-    // Set the scale based on the velocity
-    if (std::abs(enemyBullet->getComponent<CTransform>().vel.x) > 0.1f) {
-        enemyBullet->getComponent<CTransform>().scale.x = (enemyBullet->getComponent<CTransform>().vel.x > 0) ? 1 : -1;
-    }
+    auto& etx = enemy.getComponent<CTransform>();
+    bool isFacingLeft = enemy.getComponent<CState>().test(CState::isFacingLeft);
+
+    // spawned once the enemy systems are done iterating
+    auto& prefab = m_prefabs.get(isFacingLeft ? "EnemyArrowLeft" : "EnemyArrowRight");
+    m_entityManager.commands().instantiate(prefab, etx.pos);
+}
+
+// the first thing on the way from the watcher to the target is the target
+// itself, not a tile, a ground piece or another body in the target's layer
+bool Scene_Play::inSight(const Entity& watcher, const Entity& target) {
+    Physics::RayHit hit;
+    Physics::raycast(m_tileGrid, m_groundHash, m_dynamicPairs, m_entityManager,
+        watcher.getComponent<CTransform>().pos, target.getComponent<CTransform>().pos,
+        1u << m_collisionLayers.layerOf(target.getTagId()), hit);
+    return hit.entity == &target;
 }
 
 void Scene_Play::sEnemyBehavior() {
-    auto enemies = m_entityManager.getEntities("enemy");
+    auto& enemies = m_entityManager.getEntities(Tag::Enemy);
     for (auto enemy : enemies) {
         if (!enemy->hasComponent<CAttackTimer>()) continue;
 
@@ -1354,7 +1398,7 @@ void Scene_Play::sEnemyBehavior() {
         bool attacking = false;
 
         // Check for players
-        auto players = m_entityManager.getEntities("player");
+        auto& players = m_entityManager.getEntities(Tag::Player);
         for (auto player : players) {
             auto& playerTransform = player->getComponent<CTransform>();
             float distance = std::abs(transform.pos.x - playerTransform.pos.x);
@@ -1369,7 +1413,8 @@ void Scene_Play::sEnemyBehavior() {
                 enemy->getComponent<CState>().unSet(CState::isFacingLeft);
             }
 
-            if (distance < 200) {
+            // no attacking through walls
+            if (distance < 200 && inSight(*enemy, *player)) {
                 playerNearby = true;
 
                 // Attack only if cooldown is over
@@ -1377,10 +1422,10 @@ void Scene_Play::sEnemyBehavior() {
                     attackTimer.timeLeft = 2.0f;  // **Reset cooldown BEFORE attacking**
 
                     if (distance < 50) {
-                        meleeAttack(enemy);
+                        meleeAttack(*enemy);
                     }
                     else {
-                        rangedAttack(enemy);
+                        rangedAttack(*enemy);
                     }
 
                     // Set attack animation
@@ -1393,7 +1438,7 @@ void Scene_Play::sEnemyBehavior() {
 
         // If no player is nearby, patrol
         if (!playerNearby) {
-            if (checkPlatformEdge(enemy)) {
+            if (checkPlatformEdge(*enemy)) {
                 transform.vel.x *= -1;  // Reverse direction
                 transform.scale.x *= -1;  // Flip sprite direction
 
@@ -1416,47 +1461,48 @@ void Scene_Play::sEnemyBehavior() {
         // Move enemy
         transform.pos.x += transform.vel.x * m_game->deltaTime();
         transform.pos.y += transform.vel.y;
+        Physics::wake(*enemy, m_entityManager.commands());
     }
 }
 
 void Scene_Play::spawnPowerUp(const Vec2& position, const std::string& type) {
-    auto powerUp = m_entityManager.addEntity(type);
-    powerUp->addComponent<CAnimation>(m_game->assets().getAnimation(type), true);
-    powerUp->addComponent<CTransform>(position);
-    powerUp->addComponent<CBoundingBox>(Vec2(20, 20)); // Adjust the size as needed
+    m_entityManager.commands().instantiate(m_prefabs.get(type + "Drop"), position);
     std::cout << "Spawned Power-Up: " << type << " at position: " << position.x << ", " << position.y << std::endl;
 }
 
 void Scene_Play::spawnKey(const Vec2& position)
 {
-	auto key = m_entityManager.addEntity("key");
-	key->addComponent<CAnimation>(m_game->assets().getAnimation("Key"), true);
-	key->addComponent<CTransform>(position);
-	key->addComponent<CBoundingBox>(Vec2(20, 20)); // Adjust the size as needed
+	m_entityManager.commands().instantiate(m_prefabs.get("Key"), position, &m_key);
 	std::cout << "Spawned Key at position: " << position.x << ", " << position.y << std::endl;
 }
 
 void Scene_Play::spawnDoor(const Vec2& position) {
-    m_door = m_entityManager.addEntity("door");
-    m_door->addComponent<CAnimation>(m_game->assets().getAnimation("DoorClose"), true);
-    m_door->addComponent<CTransform>(position);
-    m_door->addComponent<CBoundingBox>(Vec2(100, 100)); // Adjust the size as needed
+    auto door = m_entityManager.addEntity(Tag::Door);
+    m_door = door->getHandle();
+    door->addComponent<CAnimation>(m_game->assets().getAnimation("DoorClose"), true);
+    door->addComponent<CTransform>(position);
+    door->addComponent<CBoundingBox>(Vec2(100, 100)); // Adjust the size as needed
     std::cout << "Spawned Door at position: " << position.x << ", " << position.y << std::endl;
 }
 
 void Scene_Play::spawnStrongerEnemy(const std::vector<EnemyConfig>& configs) {
+    auto& prefab = m_prefabs.get("StrongerEnemy");
+    Vec2 spriteSize = prefab.get<CAnimation>()->animation.getSize();
+
+    std::vector<Vec2> positions;
     for (const auto& config : configs) {
-        auto enemy = m_entityManager.addEntity("stronger_enemy");
-        enemy->addComponent<CAnimation>(m_game->assets().getAnimation("StrongerEnemy"), true);
+        positions.push_back(gridToMidPixel(config.X, config.Y, spriteSize));
+    }
+
+    auto enemies = m_entityManager.instantiate(prefab, configs.size(), positions);
+    for (size_t i = 0; i < configs.size(); ++i) {
+        const auto& config = configs[i];
+        auto enemy = enemies[i];
         enemy->addComponent<CBoundingBox>(Vec2(config.CW, config.CH));
-        enemy->addComponent<CState>();
         enemy->addComponent<CPlatformInfo>(config.platformStartX, config.platformEndX);
-        enemy->addComponent<CHealth>(10); 
-        enemy->addComponent<CAttackTimer>(0.5f);
 
-        Vec2 pos = gridToMidPixel(config.X, config.Y, enemy);
+        Vec2 pos = positions[i];
         std::cout << "Converted position: " << pos.x << ", " << pos.y << std::endl;
-        enemy->addComponent<CTransform>(pos);
 
         auto& transform = enemy->getComponent<CTransform>();
         transform.vel.x = config.SPEED;
@@ -1465,28 +1511,30 @@ void Scene_Play::spawnStrongerEnemy(const std::vector<EnemyConfig>& configs) {
         std::cout << "Spawned stronger enemy at: " << config.X << ", " << config.Y
             << " with weapon: " << config.WEAPON << std::endl;
 
-        m_enemyRespawnPoints[enemy] = pos;
+        m_enemyRespawnPoints[enemy->getHandle()] = pos;
     }
 }
 
 void Scene_Play::spawnChest(const Vec2& position) {
-    m_chest = m_entityManager.addEntity("chest");
-    m_chest->addComponent<CAnimation>(m_game->assets().getAnimation("ChestClose"), true);
-    m_chest->addComponent<CTransform>(position);
-    m_chest->addComponent<CBoundingBox>(Vec2(20, 20)); // Adjust the size as needed
+    auto chest = m_entityManager.addEntity(Tag::Chest);
+    m_chest = chest->getHandle();
+    chest->addComponent<CAnimation>(m_game->assets().getAnimation("ChestClose"), true);
+    chest->addComponent<CTransform>(position);
+    chest->addComponent<CBoundingBox>(Vec2(20, 20)); // Adjust the size as needed
     std::cout << "Spawned Chest at position: " << position.x << ", " << position.y << std::endl;
 }
 
 void Scene_Play::spawnBook(const Vec2& position) {
-    m_book = m_entityManager.addEntity("book");
-    m_book->addComponent<CAnimation>(m_game->assets().getAnimation("Book"), true);
-    m_book->addComponent<CTransform>(position);
-    m_book->addComponent<CBoundingBox>(Vec2(10, 10)); // Adjust the size as needed
+    auto book = m_entityManager.addEntity(Tag::Book);
+    m_book = book->getHandle();
+    book->addComponent<CAnimation>(m_game->assets().getAnimation("Book"), true);
+    book->addComponent<CTransform>(position);
+    book->addComponent<CBoundingBox>(Vec2(10, 10)); // Adjust the size as needed
     std::cout << "Spawned Book at position: " << position.x << ", " << position.y << std::endl;
 }
 
 void Scene_Play::sStrongerEnemyBehavior() {
-    auto strongerEnemies = m_entityManager.getEntities("stronger_enemy");
+    auto& strongerEnemies = m_entityManager.getEntities(Tag::StrongerEnemy);
     for (auto enemy : strongerEnemies) {
         if (!enemy->hasComponent<CAttackTimer>()) continue;
 
@@ -1499,7 +1547,7 @@ void Scene_Play::sStrongerEnemyBehavior() {
         bool attacking = false;
 
         // Check for players
-        auto players = m_entityManager.getEntities("player");
+        auto& players = m_entityManager.getEntities(Tag::Player);
         for (auto player : players) {
             auto& playerTransform = player->getComponent<CTransform>();
             float distance = std::abs(transform.pos.x - playerTransform.pos.x);
@@ -1513,7 +1561,8 @@ void Scene_Play::sStrongerEnemyBehavior() {
                 enemy->getComponent<CState>().unSet(CState::isFacingLeft);
             }
 
-            if (distance < 200) {
+            // no attacking through walls
+            if (distance < 200 && inSight(*enemy, *player)) {
                 playerNearby = true;
 
                 // Attack only if cooldown is over
@@ -1521,10 +1570,10 @@ void Scene_Play::sStrongerEnemyBehavior() {
                     attackTimer.timeLeft = 1.0f;  // Reset cooldown BEFORE attacking**
 
                     if (distance < 50) {
-                        meleeAttack(enemy);
+                        meleeAttack(*enemy);
                     }
                     else {
-                        rangedAttack(enemy);
+                        rangedAttack(*enemy);
                     }
 
                     attacking = true;  // Mark that the enemy is attacking
@@ -1534,7 +1583,7 @@ void Scene_Play::sStrongerEnemyBehavior() {
 
         // If no player is nearby, patrol
         if (!playerNearby) {
-            if (checkPlatformEdge(enemy)) {
+            if (checkPlatformEdge(*enemy)) {
                 transform.vel.x *= -1;  // Reverse direction
                 transform.scale.x *= -1;  // Flip sprite direction
 
@@ -1557,6 +1606,7 @@ void Scene_Play::sStrongerEnemyBehavior() {
         // Move enemy
         transform.pos.x += transform.vel.x * m_game->deltaTime();
         transform.pos.y += transform.vel.y;
+        Physics::wake(*enemy, m_entityManager.commands());
     }
 }
 
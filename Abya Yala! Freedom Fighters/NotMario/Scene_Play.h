@@ -4,7 +4,11 @@
 #include "Scene.h"
 #include <map>
 #include "EntityManager.h"
+#include "Physics.h"
+#include "SpriteBatch.h"
+#include "Systems.h"
 #include <queue>
+#include <random>
 
 class Scene_Play : public Scene
 {
@@ -35,11 +39,11 @@ class Scene_Play : public Scene
 
 protected:
 
-	std::shared_ptr<Entity>		m_player;
-	std::shared_ptr<Entity>		m_key;
-	std::shared_ptr<Entity>		m_door;
-	std::shared_ptr<Entity>		m_chest;
-	std::shared_ptr<Entity>		m_book;
+	EntityHandle				m_player;
+	EntityHandle				m_key;
+	EntityHandle				m_door;
+	EntityHandle				m_chest;
+	EntityHandle				m_book;
 	std::string					m_levelPath;
 	PlayerConfig				m_playerConfig;
 	std::vector<EnemyConfig>    m_enemyConfigs;
@@ -70,18 +74,47 @@ protected:
 	float m_ovalAnimationTime{ 0.0f };
 	sf::Shader m_glowShader;
 	const float POWER_UP_DROP_PROBABILITY = 0.7f; // 30% chance to drop a power-up
-	std::map<std::shared_ptr<Entity>, Vec2> m_enemyRespawnPoints; // Store respawn points for enemies
+	std::map<EntityHandle, Vec2> m_enemyRespawnPoints; // Store respawn points for enemies
+	PrefabRegistry				m_prefabs;
+	Physics::TileGrid			m_tileGrid{ m_gridSize };	// static terrain, built by loadFromFile
+	Physics::SpatialHash		m_groundHash{ 100.f };		// rebuilt when ground comes or goes
+	uint64_t					m_groundVersion{ UINT64_MAX };
+	Physics::CollisionMatrix	m_collisionLayers;
+	Physics::SweepAndPrune		m_dynamicPairs;
+	Physics::ContactCache		m_terrainContacts;		// who stands on or leans against what
+	SpriteBatch					m_sprites;
+	Physics::SpatialHash		m_renderIndex{ 256.f };	// sprite bounds of everything that never moves
+	uint64_t					m_renderIndexVersion{ UINT64_MAX };
+	std::vector<Entity*>		m_visible;
+
+	static constexpr float		RenderMargin{ 64.f };	// drawn this far past the view's edges
+	std::vector<Entity*>		m_nearby;				// broadphase results, reused every query
+	Physics::BoxBatch			m_nearbyTerrain;
+	std::vector<Physics::BatchHit>	m_terrainHits;
+	std::mt19937				m_random;				// reseeded by loadLevel
+
+	static constexpr uint32_t	RandomSeed{ 1 };		// used by a deterministic build
+	static constexpr size_t		ChecksumInterval{ 60 };	// frames between logged checksums
 
 
 	void	init(const std::string& levelPath);
 	void	registerActions();
+	void	registerCollisionLayers();
+	void	registerPrefabs();
+	const Prefab& levelPrefab(EntityTag tag, const std::string& animationName);
 	void	onEnd() override;
+	int		drawLayer(EntityTag tag) const;
+	uint64_t	staticVersion() const;
+	void	drawSprite(Entity& e, CAnimation& anim, CTransform& transform, float alpha);
+	void	setPieceAnimation(Entity& piece, const std::string& name);
+	bool	inSight(const Entity& watcher, const Entity& target);
 
 
 public:
 	Scene_Play(GameEngine* gameEngine, const std::string& levelPath);
 	
 	void update() override;
+	uint64_t checksum();
 	void sRender() override;
 	void sDoAction(const Action& action) override;
 	void updateView();
@@ -92,26 +125,32 @@ public:
 	void sLifespan();
 	
 	void sCollision();
+	void onPickup(Entity& player, Entity& pickup);
+	void onInteractive(Entity& player, Entity& thing);
+	void onEnemyShot(Entity& player, Entity& shot);
+	void onPlayerShot(Entity& arrow, Entity& enemy);
+	void onEnemyContact(Entity& player, Entity& enemy);
 	void createGround();
 	
 	void sDebug();
 	void drawLine();
-	void drawHP(std::shared_ptr<Entity> e);
+	void drawHP(Entity& e);
 	void drawCoinsCounter();
 	void drawWinScreen();
 	void drawLifeSpan();
 	void drawArrowsCounter();
 
 	void playerCheckState();
-	void respawnPlayer(std::shared_ptr<Entity> player);
-	void respawnEnemy(std::shared_ptr<Entity> enemy);
+	void respawnPlayer(Entity& player);
+	void respawnEnemy(Entity& enemy);
 
 
-	Vec2 gridToMidPixel(float gridX, float gridY, std::shared_ptr<Entity> entity);
+	Vec2 gridToMidPixel(float gridX, float gridY, const Entity& entity);
+	Vec2 gridToMidPixel(float gridX, float gridY, const Vec2& spriteSize);
 	void loadLevel(const std::string& filename);
 	void loadFromFile(const std::string& filename);
 	void spawnPlayer();
-	void spawnBullet(std::shared_ptr<Entity>);
+	void spawnBullet(Entity&);
 
 	void spawnEnemy(const std::vector<EnemyConfig>& configs);
 	void sEnemyBehavior();
@@ -119,9 +158,9 @@ public:
 	void checkWinCondition();
 	void checkLoseCondition();
 
-	void meleeAttack(std::shared_ptr<Entity> enemy);
-	void rangedAttack(std::shared_ptr<Entity> enemy);
-	bool checkPlatformEdge(std::shared_ptr<Entity> enemy);
+	void meleeAttack(Entity& enemy);
+	void rangedAttack(Entity& enemy);
+	bool checkPlatformEdge(Entity& enemy);
 	void spawnPowerUp(const Vec2& position, const std::string& type);
 	void spawnKey(const Vec2& position);
 	void spawnDoor(const Vec2& position);
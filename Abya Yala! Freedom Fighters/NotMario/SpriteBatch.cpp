@@ -0,0 +1,63 @@
+#include "SpriteBatch.h"
+
+SpriteBatch::Batch& SpriteBatch::batchFor(int layer, const sf::Texture* texture)
+{
+	// a level uses a handful of textures, a linear search beats hashing
+	for (auto& batch : m_batches)
+	{
+		if (batch.layer == layer && batch.texture == texture)
+			return batch;
+	}
+
+	m_batches.push_back({ layer, texture });
+	m_order.resize(m_batches.size());
+	for (size_t i = 0; i < m_order.size(); ++i)
+		m_order[i] = i;
+	std::stable_sort(m_order.begin(), m_order.end(), [this](size_t a, size_t b) {
+		return m_batches[a].layer < m_batches[b].layer;
+	});
+	return m_batches.back();
+}
+
+void SpriteBatch::add(const sf::Sprite& sprite, int layer)
+{
+	auto& vertices = batchFor(layer, sprite.getTexture()).vertices;
+
+	// the same four corners sf::Sprite draws, as two triangles
+	const sf::IntRect& rect = sprite.getTextureRect();
+	float width = static_cast<float>(std::abs(rect.width));
+	float height = static_cast<float>(std::abs(rect.height));
+	float left = static_cast<float>(rect.left);
+	float right = left + rect.width;
+	float top = static_cast<float>(rect.top);
+	float bottom = top + rect.height;
+
+	const sf::Transform& transform = sprite.getTransform();
+	const sf::Color& color = sprite.getColor();
+	sf::Vertex topLeft(transform.transformPoint(0.f, 0.f), color, sf::Vector2f(left, top));
+	sf::Vertex topRight(transform.transformPoint(width, 0.f), color, sf::Vector2f(right, top));
+	sf::Vertex bottomLeft(transform.transformPoint(0.f, height), color, sf::Vector2f(left, bottom));
+	sf::Vertex bottomRight(transform.transformPoint(width, height), color, sf::Vector2f(right, bottom));
+
+	vertices.append(topLeft);
+	vertices.append(topRight);
+	vertices.append(bottomLeft);
+	vertices.append(bottomLeft);
+	vertices.append(topRight);
+	vertices.append(bottomRight);
+}
+
+void SpriteBatch::draw(sf::RenderTarget& target)
+{
+	m_drawCalls = 0;
+	for (auto i : m_order)
+	{
+		auto& batch = m_batches[i];
+		if (batch.vertices.getVertexCount() == 0)
+			continue;
+
+		target.draw(batch.vertices, sf::RenderStates(batch.texture));
+		batch.vertices.clear();
+		++m_drawCalls;
+	}
+}
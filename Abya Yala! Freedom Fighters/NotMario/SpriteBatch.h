@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Common.h"
+
+// Collects the sprites of a frame into one triangle list per layer and
+// texture, so drawing them costs one draw call per texture rather than one
+// per sprite. Layers are drawn lowest first. Within a layer the sprites of
+// one texture keep the order they were added in, and the textures come in
+// the order the batch first saw them, so sprites that overlap and use
+// different textures belong on different layers.
+class SpriteBatch
+{
+	struct Batch
+	{
+		int					layer;
+		const sf::Texture*	texture;
+		sf::VertexArray		vertices{ sf::Triangles };
+	};
+
+	std::vector<Batch>		m_batches;		// kept between frames, so are the vertex buffers
+	std::vector<size_t>		m_order;		// m_batches by layer, rebuilt when a batch is added
+	size_t					m_drawCalls{ 0 };
+
+	Batch&	batchFor(int layer, const sf::Texture* texture);
+
+public:
+	// the sprite as it is now: position, origin, scale, rotation, texture
+	// rect and colour are all baked into its vertices
+	void	add(const sf::Sprite& sprite, int layer = 0);
+
+	// every batch with something in it, then empties them for the next frame
+	void	draw(sf::RenderTarget& target);
+
+	size_t	drawCalls() const { return m_drawCalls; }	// of the last draw()
+};
@@ -0,0 +1,223 @@
+#include "Systems.h"
+#include "Entity.h"
+
+namespace {
+
+    // candidates near e, padded by its own size since resolving one contact
+    // can push it into the next
+    template <typename Grid, typename Out>
+    Out& queryNear(const Grid& terrain, Entity& e, Out& out) {
+        terrain.query(Physics::getAABB(e).expanded(e.getComponent<CBoundingBox>().size), out);
+        return out;
+    }
+
+    // tiles touching e where it started this pass, tested as one batch
+    std::vector<Physics::BatchHit>& tileHits(Entity& e, Systems::Terrain& terrain) {
+        Physics::overlapBatch(e, queryNear(terrain.tiles, e, terrain.nearbyTiles), terrain.hits);
+        return terrain.hits;
+    }
+
+    uint32_t groundKey(const Entity& g) {
+        return Systems::GroundBit | static_cast<uint32_t>(g.getId());
+    }
+
+    // an entity that stood on something last step and has only been pulled
+    // down since can only have sunk into that same piece, so that one contact
+    // is all there is to resolve
+    bool stillResting(Entity& e, Systems::Terrain& terrain) {
+        auto rest = terrain.contacts.support(e);
+        auto& tx = e.getComponent<CTransform>();
+        if (!rest || tx.pos.x != rest->at.x || tx.pos.y < rest->at.y)
+            return false;
+
+        auto overlap = Physics::getOverlap(e, rest->box);
+        if (overlap.x > 0 && overlap.y > 0) {
+            tx.pos.y -= overlap.y;
+            tx.vel.y = 0.f;
+            if (e.hasComponent<CInput>())
+                e.getComponent<CInput>().canJump = true;
+        }
+        terrain.contacts.touch(e, rest->other, rest->box, rest->normal);
+        return true;
+    }
+}
+
+void Systems::moveBodies(EntityManager& entities, ThreadPool& threads) {
+    // sleeping bodies are not in the CAwake pool, so they cost nothing here
+    auto& commands = entities.commands();
+    entities.parallelEach<CAwake, CBody, CTransform>(threads, 1024, [&commands](Entity* e, CAwake&, CBody& body, CTransform& tx) {
+        bool supported = e->hasComponent<CState>() && e->getComponent<CState>().test(CState::isGrounded);
+        if (Physics::integrate(body, tx, supported))
+            commands.remove<CAwake>(e->getHandle());
+    });
+}
+
+void Systems::applyGravity(EntityManager& entities, EntityTag tag, float gravity) {
+    // a sleeping one is already standing on something
+    for (auto e : entities.getEntities(tag)) {
+        if (Physics::isAsleep(*e))
+            continue;
+        e->getComponent<CTransform>().vel.y += gravity;
+    }
+}
+
+void Systems::playerTerrain(Entity& p, Terrain& terrain) {
+    if (stillResting(p, terrain)) {
+        terrain.contacts.settle(p);
+        return;
+    }
+
+    for (auto& hit : tileHits(p, terrain)) {
+        // an earlier contact may already have pushed the player clear
+        auto t = terrain.nearbyTiles.box(hit.index);
+        auto overlap = Physics::getOverlap(p, t);
+        if (overlap.x > 0 && overlap.y > 0) // +ve overlap in both x and y means collision
+        {
+            auto& prevOverlap = hit.prevOverlap;
+            auto& ptx = p.getComponent<CTransform>();
+            auto tileCenter = t.center();
+            Vec2 normal;    // the way the tile pushed the player
+
+            // collision is in the y direction
+            if (prevOverlap.x > 0) {
+                if (ptx.prevPos.y < tileCenter.y) {
+                    // player standing on something isGrounded
+                    ptx.pos.y -= overlap.y;
+                    p.getComponent<CInput>().canJump = true;
+                    normal = Vec2(0.f, -1.f);
+                }
+                else {
+                    // player hit something from below
+                    ptx.pos.y += overlap.y;
+                    normal = Vec2(0.f, 1.f);
+                }
+                ptx.vel.y = 0.f;
+            }
+
+            // collision is in the x direction
+            if (prevOverlap.y > 0) {
+                if (ptx.prevPos.x < tileCenter.x) // player left of tile
+                    ptx.pos.x -= overlap.x;
+                else
+                    ptx.pos.x += overlap.x;
+                if (normal.y == 0.f)
+                    normal = Vec2(ptx.prevPos.x < tileCenter.x ? -1.f : 1.f, 0.f);
+            }
+
+            if (normal.x != 0.f || normal.y != 0.f)
+                terrain.contacts.touch(p, terrain.nearbyTiles.id[hit.index], t, normal);
+        }
+    }
+
+    // Check collision with the ground
+    for (auto g : queryNear(terrain.ground, p, terrain.nearbyGround)) {
+        auto overlap = Physics::getOverlap(p, *g);
+        if (overlap.x > 0 && overlap.y > 0) {
+            auto prevOverlap = Physics::getPreviousOverlap(p, *g);
+            auto& ptx = p.getComponent<CTransform>();
+            auto& gtx = g->getComponent<CTransform>();
+
+            // Y-axis collision (ground)
+            if (prevOverlap.x > 0) {
+                if (ptx.prevPos.y < gtx.prevPos.y) {  // Player is above ground
+                    ptx.pos.y -= overlap.y;
+                    p.getComponent<CInput>().canJump = true;
+                    terrain.contacts.touch(p, groundKey(*g), Physics::getAABB(*g), Vec2(0.f, -1.f));
+                }
+                ptx.vel.y = 0.f;
+            }
+        }
+    }
+    terrain.contacts.settle(p);
+}
+
+void Systems::enemyTerrain(Entity& e, Terrain& terrain) {
+    // a sleeping enemy has not moved, so its contacts still hold as they are
+    if (Physics::isAsleep(e) || stillResting(e, terrain)) {
+        terrain.contacts.settle(e);
+        return;
+    }
+
+    for (auto& hit : tileHits(e, terrain)) {
+        auto t = terrain.nearbyTiles.box(hit.index);
+        auto overlap = Physics::getOverlap(e, t);
+        if (overlap.x > 0 && overlap.y > 0) {
+            auto& prevOverlap = hit.prevOverlap;
+            auto& etx = e.getComponent<CTransform>();
+
+            if (prevOverlap.x > 0) {
+                bool above = etx.prevPos.y < t.center().y;
+                if (above) {
+                    etx.pos.y -= overlap.y;
+                }
+                else {
+                    etx.pos.y += overlap.y;
+                }
+                etx.vel.y = 0.f;
+                terrain.contacts.touch(e, terrain.nearbyTiles.id[hit.index], t, Vec2(0.f, above ? -1.f : 1.f));
+            }
+        }
+    }
+
+    // Check collision with the ground
+    for (auto g : queryNear(terrain.ground, e, terrain.nearbyGround)) {
+        auto overlap = Physics::getOverlap(e, *g);
+        if (overlap.x > 0 && overlap.y > 0) {
+            auto prevOverlap = Physics::getPreviousOverlap(e, *g);
+            auto& etx = e.getComponent<CTransform>();
+            auto& gtx = g->getComponent<CTransform>();
+
+            if (prevOverlap.x > 0) {
+                bool above = etx.prevPos.y < gtx.prevPos.y;
+                if (above) {
+                    etx.pos.y -= overlap.y;
+                }
+                else {
+                    etx.pos.y += overlap.y;
+                }
+                etx.vel.y = 0.f;
+                terrain.contacts.touch(e, groundKey(*g), Physics::getAABB(*g), Vec2(0.f, above ? -1.f : 1.f));
+            }
+        }
+    }
+    terrain.contacts.settle(e);
+}
+
+bool Systems::hitsGround(Entity& e, Terrain& terrain) {
+    bool swept = e.getComponent<CBoundingBox>().swept;
+    terrain.ground.query(swept ? Physics::getSweptAABB(e) : Physics::getAABB(e), terrain.nearbyGround);
+    for (auto g : terrain.nearbyGround) {
+        if (swept && Physics::timeOfImpact(e, Physics::getAABB(*g)) >= 0.f)
+            return true;
+        auto overlap = Physics::getOverlap(e, *g);
+        if (!swept && overlap.x > 0 && overlap.y > 0)
+            return true;
+    }
+    return false;
+}
+
+void Systems::updateGrounded(EntityManager& entities, Physics::ContactCache& contacts) {
+    contacts.end();
+    for (auto& contact : contacts.events()) {
+        auto e = entities.get(contact.entity);
+        if (contact.normal.y >= 0.f || !e || !e->isActive() || !e->hasComponent<CState>())
+            continue;
+        if (contact.phase == Physics::ContactCache::Phase::Enter)
+            e->getComponent<CState>().set(CState::isGrounded);
+        else if (!contacts.supported(contact.entity))
+            e->getComponent<CState>().unSet(CState::isGrounded);
+    }
+}
+
+void Systems::dynamicPairs(EntityManager& entities, Physics::SweepAndPrune& pairs, Physics::CollisionMatrix& layers) {
+    pairs.update(entities, layers);
+    layers.dispatch(pairs.pairs());
+}
+
+void Systems::advanceAnimations(EntityManager& entities, ThreadPool& threads) {
+    entities.parallelEach<CAnimation>(threads, 512, [](Entity* e, CAnimation& anim) {
+        anim.animation.update(anim.repeat);
+        if (anim.animation.hasEnded())
+            e->destroy();
+    });
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Common.h"
+#include "EntityManager.h"
+#include "Physics.h"
+#include "ThreadPool.h"
+
+// The entity loops of Scene_Play's systems that need nothing from the scene
+// itself. The scene calls them with its own state and the benchmark with a
+// synthetic level, so both time the same code.
+namespace Systems
+{
+	// contact cache keys: merged tile rectangles go by index, ground by entity id
+	constexpr uint32_t GroundBit{ 0x80000000u };
+
+	// what the terrain pass of sCollision works with: the level's static
+	// pieces, the contacts kept between steps and scratch space for queries
+	struct Terrain
+	{
+		const Physics::TileGrid&		tiles;
+		const Physics::SpatialHash&		ground;
+		Physics::ContactCache&			contacts;
+		Physics::BoxBatch&				nearbyTiles;
+		std::vector<Physics::BatchHit>&	hits;
+		std::vector<Entity*>&			nearbyGround;
+	};
+
+	// every awake body one step along its velocity, spread over the pool.
+	// Grounded bodies may fall asleep, see Physics::integrate
+	void moveBodies(EntityManager& entities, ThreadPool& threads);
+	// pulls down every entity of tag that is not asleep on something, called
+	// before moveBodies so the terrain pass takes the pull back in the same step
+	void applyGravity(EntityManager& entities, EntityTag tag, float gravity);
+
+	// pushes the player out of the terrain: tiles from above, below and
+	// the sides, ground only from above
+	void playerTerrain(Entity& player, Terrain& terrain);
+	// pushes an enemy out of the terrain from above or below
+	void enemyTerrain(Entity& enemy, Terrain& terrain);
+	// whether e touched a ground piece this step: swept boxes anywhere along
+	// the way from prevPos, so a fast one cannot skip a thin piece, the rest
+	// where they are now
+	bool hitsGround(Entity& e, Terrain& terrain);
+	// ends the terrain step, grounded only changes when a contact underneath
+	// begins or ends
+	void updateGrounded(EntityManager& entities, Physics::ContactCache& contacts);
+
+	// everything that moves against everything else that moves, handed to
+	// the handlers registered with layers
+	void dynamicPairs(EntityManager& entities, Physics::SweepAndPrune& pairs, Physics::CollisionMatrix& layers);
+
+	// advances every animation, entities whose animation ended are destroyed
+	void advanceAnimations(EntityManager& entities, ThreadPool& threads);
+}
@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t workers)
+{
+	for (size_t i = 0; i < workers; ++i)
+		m_workers.push_back(std::make_unique<Worker>());
+
+	for (size_t i = 0; i < workers; ++i)
+		m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& thread : m_threads)
+		thread.join();
+}
+
+size_t ThreadPool::defaultWorkerCount()
+{
+	size_t hardware = std::thread::hardware_concurrency();
+	return hardware > 1 ? hardware - 1 : 0;
+}
+
+bool ThreadPool::popTask(size_t self, Task& task)
+{
+	// own deque first, newest task, then steal the oldest task of the others
+	for (size_t i = 0; i < m_workers.size(); ++i)
+	{
+		size_t index = (self == NoWorker) ? i : (self + i) % m_workers.size();
+		auto& worker = *m_workers[index];
+
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (worker.tasks.empty())
+			continue;
+
+		if (index == self)
+		{
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+		}
+		else
+		{
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+		}
+		m_queued.fetch_sub(1);
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+	Task task;
+	while (true)
+	{
+		if (popTask(index, task))
+		{
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wake.wait(lock, [this] { return m_stopping || m_queued.load() > 0; });
+		if (m_stopping && m_queued.load() == 0)
+			return;
+	}
+}
+
+void ThreadPool::run(std::vector<Task>& tasks)
+{
+	if (m_workers.empty() || tasks.size() <= 1)
+	{
+		for (auto& task : tasks)
+			task();
+		return;
+	}
+
+	// the calling thread keeps the first task, the rest are dealt round robin
+	std::atomic<size_t> remaining{ tasks.size() };
+	for (size_t i = 1; i < tasks.size(); ++i)
+	{
+		auto& worker = *m_workers[m_nextWorker.fetch_add(1) % m_workers.size()];
+		{
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			worker.tasks.emplace_back([&remaining, &task = tasks[i]] {
+				task();
+				remaining.fetch_sub(1, std::memory_order_release);
+			});
+		}
+		m_queued.fetch_add(1);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wake.notify_all();
+
+	tasks[0]();
+	remaining.fetch_sub(1, std::memory_order_release);
+
+	// help with whatever is queued until the whole batch is done
+	Task task;
+	while (remaining.load(std::memory_order_acquire) > 0)
+	{
+		if (popTask(NoWorker, task))
+		{
+			task();
+			task = nullptr;
+		}
+		else
+			std::this_thread::yield();
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque.
+// A worker pops from the back of its own deque and steals from the front of
+// the others when it runs dry. The thread calling run() works on the batch
+// too, so a pool with no workers simply runs everything inline.
+class ThreadPool
+{
+public:
+	using Task = std::function<void()>;
+
+private:
+	struct Worker
+	{
+		std::mutex			mutex;
+		std::deque<Task>	tasks;
+	};
+
+	std::vector<std::unique_ptr<Worker>>	m_workers;
+	std::vector<std::thread>				m_threads;
+	std::atomic<size_t>						m_queued{ 0 };
+	std::atomic<size_t>						m_nextWorker{ 0 };
+	std::mutex								m_sleepMutex;
+	std::condition_variable					m_wake;
+	bool									m_stopping{ false };
+
+	static constexpr size_t NoWorker{ static_cast<size_t>(-1) };
+
+	bool	popTask(size_t self, Task& task);
+	void	workerLoop(size_t index);
+
+public:
+	explicit ThreadPool(size_t workers = defaultWorkerCount());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	static size_t	defaultWorkerCount();
+	size_t			concurrency() const { return m_threads.size() + 1; }
+
+	// runs every task and returns once all of them have finished
+	void run(std::vector<Task>& tasks);
+
+	// calls fn(begin, end) over [0, count) in chunks of at least grain items,
+	// small ranges run inline on the calling thread
+	template <typename F>
+	void parallelFor(size_t count, size_t grain, F&& fn)
+	{
+		if (count == 0)
+			return;
+
+		size_t chunks = std::min((count + grain - 1) / grain, concurrency() * 4);
+		if (chunks <= 1 || m_threads.empty())
+		{
+			fn(size_t(0), count);
+			return;
+		}
+
+		std::vector<Task> tasks;
+		tasks.reserve(chunks);
+		size_t step = (count + chunks - 1) / chunks;
+		for (size_t begin = 0; begin < count; begin += step)
+		{
+			size_t end = std::min(begin + step, count);
+			tasks.emplace_back([&fn, begin, end] { fn(begin, end); });
+		}
+		run(tasks);
+	}
+};
@@ -96,7 +96,13 @@ Vec2& Vec2::operator-=(const Vec2& rhs)
 
 Vec2 Vec2::operator-(const Vec2& rhs) const
 {
-	return Vec2(*this) += rhs;
+	return Vec2(*this) -= rhs;
+}
+
+
+Vec2 Vec2::lerp(const Vec2& to, float t) const
+{
+	return Vec2(x + (to.x - x) * t, y + (to.y - y) * t);
 }
 
 
@@ -23,6 +23,8 @@ struct Vec2
 
 	Vec2	operator*(const float& rhs) const;
 	 
+	Vec2	lerp(const Vec2& to, float t) const;	// this at t = 0, to at t = 1
+
 	float	length() const;
 	float	dist(const Vec2& rhs); 
 	Vec2	normalize() const; 